@@ -0,0 +1,73 @@
+#include "arena.h"
+#include "scheduler.h"
+#include <cstdlib>
+#include <iostream>
+
+#define CHUNK_DATA_SIZE (ARENA_CHUNK_SIZE - offsetof(ArenaChunk, data))
+
+ArenaChunk* Arenas::pool = nullptr;
+
+// The slow path: starts a new chunk, from the pool if it has one, or gives a large allocation a block of its own.
+// The pool is shared, and a switch inside malloc could deadlock on its lock, so the timer signal is held off.
+char* Arenas::refill(Arena* arena, size_t size) {
+  Scheduler::blockTimerSignal();
+  if (size > CHUNK_DATA_SIZE) {
+    auto* block = static_cast<ArenaChunk*>(malloc(offsetof(ArenaChunk, data) + size));
+    if (block == nullptr) {
+      std::cerr << "system error: cannot allocate arena memory\n";
+      exit(1);
+    }
+    block->next = arena->large;
+    arena->large = block;
+    Scheduler::unblockTimerSignal();
+    return block->data;
+  }
+
+  ArenaChunk* chunk = pool;
+  if (chunk != nullptr) {
+    pool = chunk->next;
+  } else {
+    chunk = static_cast<ArenaChunk*>(malloc(ARENA_CHUNK_SIZE));
+    if (chunk == nullptr) {
+      std::cerr << "system error: cannot allocate arena memory\n";
+      exit(1);
+    }
+  }
+  chunk->next = arena->chunks;
+  if (arena->chunks == nullptr) {
+    arena->oldest = chunk;
+  }
+  arena->chunks = chunk;
+  arena->next = chunk->data + size;
+  arena->end = chunk->data + CHUNK_DATA_SIZE;
+  Scheduler::unblockTimerSignal();
+  return chunk->data;
+}
+
+// Only the owning thread allocates from its arena, so the fast path is a bump of its free pointer.
+void* Arenas::alloc(Arena* arena, size_t size) {
+  size = (size + ARENA_ALIGN - 1) & ~static_cast<size_t>(ARENA_ALIGN - 1);
+  if (size == 0) {
+    size = ARENA_ALIGN;
+  }
+  if (size <= static_cast<size_t>(arena->end - arena->next)) {
+    char* block = arena->next;
+    arena->next += size;
+    return block;
+  }
+  return refill(arena, size);
+}
+
+// Splices all of the arena's chunks back into the pool in one step. Timer signal blocked.
+void Arenas::release(Arena* arena) {
+  if (arena->chunks != nullptr) {
+    arena->oldest->next = pool;
+    pool = arena->chunks;
+  }
+  while (arena->large != nullptr) {
+    ArenaChunk* block = arena->large;
+    arena->large = block->next;
+    free(block);
+  }
+  *arena = Arena{};
+}
@@ -0,0 +1,40 @@
+//
+// Per-thread bump arenas behind uthread_alloc. A thread carves its allocations out of fixed-size chunks taken from a
+// process-wide pool, without locking or freeing anything, and gives all of its chunks back to the pool at once when
+// it is destroyed. Only allocations larger than a chunk get a block of their own, freed at the same time.
+//
+
+#ifndef _ARENA_H_
+#define _ARENA_H_
+
+#include <cstddef>
+
+#define ARENA_CHUNK_SIZE (64 * 1024)    /* bytes per pooled chunk, header included */
+#define ARENA_ALIGN 16                  /* alignment of every allocation, as malloc's */
+
+struct ArenaChunk {
+    ArenaChunk* next;
+    alignas(ARENA_ALIGN) char data[1];
+};
+
+// A thread's arena: the chunks it has filled so far, newest first, and the free part of the newest one.
+struct Arena {
+    ArenaChunk* chunks;
+    ArenaChunk* oldest;     // last chunk of the list, for splicing the whole list back into the pool
+    ArenaChunk* large;      // blocks of allocations that do not fit a chunk
+    char* next;
+    char* end;
+};
+
+class Arenas {
+private:
+    static char* refill(Arena* arena, size_t size);
+
+    static ArenaChunk* pool;
+
+public:
+    static void* alloc(Arena* arena, size_t size);
+    static void release(Arena* arena);
+};
+
+#endif //_ARENA_H_
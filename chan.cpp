@@ -0,0 +1,256 @@
+#include "chan.h"
+#include "scheduler.h"
+#include "waitqueue.h"
+#include <cstring>
+#include <iostream>
+
+// Everything here runs with the timer signal blocked. A value always moves in one step, from the sender's storage
+// into either a buffer slot or a parked receiver's storage, and a parked peer never needs to run to complete the
+// transfer: it only wakes up to find it done.
+
+// Static variables initialization
+unsigned Chan::selectRotor = 0;
+
+//************************* Implementation of the private functions ****************************************************
+char* Chan::slot(uthread_chan* chan, size_t index) {
+  return chan->buffer + ((chan->head + index) % chan->capacity) * chan->elemSize;
+}
+
+// The peer has what it waited for and will use it right away, so it runs next.
+void Chan::wake(uthread_waiter* waiter, int result) {
+  waiter->result = result;
+  Scheduler::unpark(waiter, true);
+}
+
+// Channels created without a move function carry plain data.
+void Chan::transfer(uthread_chan* chan, void* dst, void* src) {
+  if (chan->move != nullptr) {
+    chan->move(dst, src);
+  } else {
+    memcpy(dst, src, chan->elemSize);
+  }
+}
+
+// Runs the first ready case, scanning from first so that a case listed early cannot starve the others. Returns its
+// index, or -1 if none is ready.
+int Chan::selectReady(uthread_select_case_t* cases, int count, int first) {
+  for (int k = 0; k < count; k++) {
+    int i = (first + k) % count;
+    uthread_chan* chan = cases[i].chan;
+    if (chan == nullptr) {
+      continue;
+    }
+    if (cases[i].op == UTHREAD_SELECT_SEND) {
+      if (trySendLocked(chan, cases[i].elem)) {
+        return i;
+      }
+    } else if (tryRecvLocked(chan, cases[i].elem)) {
+      return i;
+    } else if (chan->closed) {
+      cases[i].closed = 1;
+      return i;
+    }
+  }
+  return -1;
+}
+
+// **************************** Implementation of the Chan API ********************************************************
+// Receivers only wait while the buffer is empty, so a parked receiver takes precedence over the buffer.
+bool Chan::trySendLocked(uthread_chan* chan, void* elem) {
+  uthread_waiter* receiver = WaitQueue::pop(&chan->receivers);
+  if (receiver != nullptr) {
+    transfer(chan, Scheduler::waiterData(receiver), elem);
+    wake(receiver, WAIT_HANDOFF);
+    return true;
+  }
+  if (chan->count < chan->capacity) {
+    char* tail = slot(chan, chan->count);
+    transfer(chan, tail, elem);
+    chan->count++;
+    return true;
+  }
+  return false;
+}
+
+// Senders only wait while the buffer is full, so the buffer is drained first and a parked sender refills it.
+bool Chan::tryRecvLocked(uthread_chan* chan, void* elem) {
+  uthread_waiter* sender;
+  if (chan->count > 0) {
+    char* oldest = slot(chan, 0);
+    transfer(chan, elem, oldest);
+    if (chan->destroy != nullptr) {
+      chan->destroy(oldest);
+    }
+    chan->head = (chan->head + 1) % chan->capacity;
+    chan->count--;
+    if ((sender = WaitQueue::pop(&chan->senders)) != nullptr) {
+      char* tail = slot(chan, chan->count);
+      transfer(chan, tail, Scheduler::waiterData(sender));
+      chan->count++;
+      wake(sender, WAIT_HANDOFF);
+    }
+    return true;
+  }
+  if ((sender = WaitQueue::pop(&chan->senders)) != nullptr) {
+    transfer(chan, elem, Scheduler::waiterData(sender));
+    wake(sender, WAIT_HANDOFF);
+    return true;
+  }
+  return false;
+}
+
+uthread_chan* Chan::create(size_t elemSize, size_t capacity, chan_move_fn move, chan_destroy_fn destroy) {
+  Scheduler::blockTimerSignal();
+  auto* chan = new(std::nothrow) uthread_chan();
+  char* buffer = capacity > 0 ? new(std::nothrow) char[elemSize * capacity] : nullptr;
+  if (chan == nullptr || (capacity > 0 && buffer == nullptr)) {
+    std::cerr << "system error: cannot allocate channel" << std::endl;
+    exit(1);
+  }
+  chan->elemSize = elemSize;
+  chan->capacity = capacity;
+  chan->buffer = buffer;
+  chan->move = move;
+  chan->destroy = destroy;
+  WaitQueue::init(&chan->senders);
+  WaitQueue::init(&chan->receivers);
+  Scheduler::unblockTimerSignal();
+  return chan;
+}
+
+// Returns 1 if the deadline passed before the value could be sent.
+int Chan::send(uthread_chan* chan, void* elem, long long deadline) {
+  Scheduler::blockTimerSignal();
+  if (chan->closed) {
+    std::cerr << "thread library error: send on a closed channel" << std::endl;
+    Scheduler::unblockTimerSignal();
+    return -1;
+  }
+  if (trySendLocked(chan, elem)) {
+    Scheduler::unblockTimerSignal();
+    return 0;
+  }
+
+  uthread_waiter& waiter = *Scheduler::takeWaiters(1);
+  waiter.data = elem;
+  Scheduler::addWaiter(&chan->senders, &waiter);
+  if (Scheduler::parkCurrent(0, deadline) < 0) {
+    return -1;
+  }
+  if (waiter.result == WAIT_CLOSED) {
+    std::cerr << "thread library error: channel closed while sending" << std::endl;
+    return -1;
+  }
+  return waiter.result == WAIT_TIMEDOUT ? 1 : 0;
+}
+
+// Returns 0 with a value, 1 once the channel is closed and drained, 2 if the deadline passed first.
+int Chan::recv(uthread_chan* chan, void* elem, long long deadline) {
+  Scheduler::blockTimerSignal();
+  if (tryRecvLocked(chan, elem)) {
+    Scheduler::unblockTimerSignal();
+    return 0;
+  }
+  if (chan->closed) {
+    Scheduler::unblockTimerSignal();
+    return 1;
+  }
+
+  uthread_waiter& waiter = *Scheduler::takeWaiters(1);
+  waiter.data = elem;
+  Scheduler::addWaiter(&chan->receivers, &waiter);
+  if (Scheduler::parkCurrent(0, deadline) < 0) {
+    return -1;
+  }
+  if (waiter.result == WAIT_TIMEDOUT) {
+    return 2;
+  }
+  return waiter.result == WAIT_CLOSED ? 1 : 0;
+}
+
+// Parked receivers wake up empty-handed and parked senders fail; values already buffered can still be received.
+int Chan::close(uthread_chan* chan) {
+  Scheduler::blockTimerSignal();
+  if (chan->closed) {
+    std::cerr << "thread library error: channel is already closed" << std::endl;
+    Scheduler::unblockTimerSignal();
+    return -1;
+  }
+  chan->closed = true;
+  Scheduler::unparkAll(&chan->receivers, WAIT_CLOSED);
+  Scheduler::unparkAll(&chan->senders, WAIT_CLOSED);
+  Scheduler::unblockTimerSignal();
+  return 0;
+}
+
+int Chan::destroy(uthread_chan* chan) {
+  Scheduler::blockTimerSignal();
+  if (!WaitQueue::empty(&chan->senders) || !WaitQueue::empty(&chan->receivers)) {
+    std::cerr << "thread library error: cannot destroy a channel that is waited on" << std::endl;
+    Scheduler::unblockTimerSignal();
+    return -1;
+  }
+  if (chan->destroy != nullptr) {
+    for (size_t i = 0; i < chan->count; i++) {
+      chan->destroy(slot(chan, i));
+    }
+  }
+  delete[] chan->buffer;
+  delete chan;
+  Scheduler::unblockTimerSignal();
+  return 0;
+}
+
+// Parks on every channel at once, one waiter per case. Whichever peer completes an operation first unparks the
+// thread, and unparking unlinks the other waiters in the same critical section, so exactly one case fires.
+int Chan::select(uthread_select_case_t* cases, int count, int timeoutQuantums, long long deadline) {
+  Scheduler::blockTimerSignal();
+  for (int i = 0; i < count; i++) {
+    cases[i].closed = 0;
+    if (cases[i].chan != nullptr && cases[i].op == UTHREAD_SELECT_SEND && cases[i].chan->closed) {
+      std::cerr << "thread library error: send on a closed channel" << std::endl;
+      Scheduler::unblockTimerSignal();
+      return -1;
+    }
+  }
+  int ready = selectReady(cases, count, count > 0 ? static_cast<int>(selectRotor++ % count) : 0);
+  if (ready >= 0 || timeoutQuantums == UTHREAD_SELECT_NOWAIT) {
+    Scheduler::unblockTimerSignal();
+    return ready >= 0 ? ready : count;
+  }
+
+  uthread_waiter* waiters = Scheduler::takeWaiters(count);
+  int queued = 0;
+  for (int i = 0; i < count; i++) {
+    uthread_chan* chan = cases[i].chan;
+    if (chan == nullptr) {
+      continue;
+    }
+    waiters[i].data = cases[i].elem;
+    Scheduler::addWaiter(cases[i].op == UTHREAD_SELECT_SEND ? &chan->senders : &chan->receivers, &waiters[i]);
+    queued++;
+  }
+  if (queued == 0 && timeoutQuantums == 0 && deadline == 0) {
+    std::cerr << "thread library error: select with no channels and no timeout would wait forever" << std::endl;
+    Scheduler::unblockTimerSignal();
+    return -1;
+  }
+  if (Scheduler::parkCurrent(timeoutQuantums, deadline) < 0) {
+    return -1;
+  }
+
+  for (int i = 0; i < count; i++) {
+    if (waiters[i].result == WAIT_HANDOFF) {
+      return i;
+    }
+    if (waiters[i].result == WAIT_CLOSED) {
+      if (cases[i].op == UTHREAD_SELECT_SEND) {
+        std::cerr << "thread library error: channel closed while sending" << std::endl;
+        return -1;
+      }
+      cases[i].closed = 1;
+      return i;
+    }
+  }
+  return count; // timed out
+}
@@ -0,0 +1,51 @@
+//
+// Go-style channels built on the scheduler's wait queues.
+//
+
+#ifndef _CHAN_H_
+#define _CHAN_H_
+
+#include "uthreads.h"
+#include <stddef.h>
+
+// Moves the element at src into the uninitialized storage at dst. The source stays owned by whoever passed it in.
+typedef void (*chan_move_fn)(void* dst, void* src);
+// Destroys an element left in the channel's buffer. May be null for plain data.
+typedef void (*chan_destroy_fn)(void* elem);
+
+struct uthread_chan {
+    size_t elemSize;
+    size_t capacity;            // 0 for an unbuffered channel
+    size_t count;               // elements currently buffered
+    size_t head;                // ring index of the oldest buffered element
+    char* buffer;
+    bool closed;
+    chan_move_fn move;
+    chan_destroy_fn destroy;
+    uthread_waitq_t senders;    // waiter data points at the value to send
+    uthread_waitq_t receivers;  // waiter data points at the storage to receive into
+};
+
+class Chan {
+private:
+    static char* slot(uthread_chan* chan, size_t index);
+    static void wake(uthread_waiter* waiter, int result);
+    static void transfer(uthread_chan* chan, void* dst, void* src);
+    static int selectReady(uthread_select_case_t* cases, int count, int first);
+
+    static unsigned selectRotor;
+
+public:
+    // Non-blocking halves of send and recv, shared with select. Timer signal blocked.
+    static bool trySendLocked(uthread_chan* chan, void* elem);
+    static bool tryRecvLocked(uthread_chan* chan, void* elem);
+
+    static uthread_chan* create(size_t elemSize, size_t capacity, chan_move_fn move, chan_destroy_fn destroy);
+    static int send(uthread_chan* chan, void* elem, long long deadline = 0);
+    static int recv(uthread_chan* chan, void* elem, long long deadline = 0);
+    static int close(uthread_chan* chan);
+    static int destroy(uthread_chan* chan);
+    static int select(uthread_select_case_t* cases, int count, int timeoutQuantums, long long deadline = 0);
+};
+
+#endif //_CHAN_H_
@@ -0,0 +1,63 @@
+//
+// Typed C++ front end for channels. Values are moved, never copied bytewise, so any movable T works.
+//
+
+#ifndef _CHANNEL_H_
+#define _CHANNEL_H_
+
+#include "chan.h"
+#include <new>
+#include <type_traits>
+#include <utility>
+
+template <typename T>
+class Channel {
+private:
+    static void moveElem(void* dst, void* src) {
+        new(dst) T(std::move(*static_cast<T*>(src)));
+    }
+
+    static void destroyElem(void* elem) {
+        static_cast<T*>(elem)->~T();
+    }
+
+    uthread_chan* chan;
+
+public:
+    explicit Channel(size_t capacity = 0)
+        : chan(Chan::create(sizeof(T), capacity, &moveElem, &destroyElem)) {}
+
+    ~Channel() {
+        Chan::destroy(chan);
+    }
+
+    Channel(const Channel&) = delete;
+    Channel& operator=(const Channel&) = delete;
+
+    // Returns false if the channel is closed.
+    bool send(T value) {
+        return Chan::send(chan, &value) == 0;
+    }
+
+    // Returns false once the channel is closed and drained; out is left untouched then.
+    bool recv(T& out) {
+        typename std::aligned_storage<sizeof(T), alignof(T)>::type storage;
+        if (Chan::recv(chan, &storage) != 0) {
+            return false;
+        }
+        T* value = reinterpret_cast<T*>(&storage);
+        out = std::move(*value);
+        value->~T();
+        return true;
+    }
+
+    int close() {
+        return Chan::close(chan);
+    }
+
+    uthread_chan* handle() {
+        return chan;
+    }
+};
+
+#endif //_CHANNEL_H_
@@ -0,0 +1,165 @@
+#include "deadline.h"
+#include "poller.h"
+#include <cerrno>
+#include <cstdint>
+#include <ctime>
+#include <iostream>
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+// All of these run with the timer signal blocked.
+
+#define NSECS_PER_SEC 1000000000LL
+
+// Static variables initialization
+long long Deadlines::when[DEADLINE_SLOTS];
+int Deadlines::heap[DEADLINE_SLOTS];
+int Deadlines::position[DEADLINE_SLOTS];
+int Deadlines::count = 0;
+int Deadlines::timerFd = -1;
+long long Deadlines::armed = 0;
+
+//************************* Implementation of the private functions ****************************************************
+void Deadlines::swap(int a, int b) {
+  int slot = heap[a];
+  heap[a] = heap[b];
+  heap[b] = slot;
+  position[heap[a]] = a + 1;
+  position[heap[b]] = b + 1;
+}
+
+void Deadlines::siftUp(int index) {
+  while (index > 0) {
+    int parent = (index - 1) / 2;
+    if (when[heap[parent]] <= when[heap[index]]) {
+      return;
+    }
+    swap(index, parent);
+    index = parent;
+  }
+}
+
+void Deadlines::siftDown(int index) {
+  while (true) {
+    int smallest = index;
+    for (int child = 2 * index + 1; child <= 2 * index + 2 && child < count; child++) {
+      if (when[heap[child]] < when[heap[smallest]]) {
+        smallest = child;
+      }
+    }
+    if (smallest == index) {
+      return;
+    }
+    swap(index, smallest);
+    index = smallest;
+  }
+}
+
+void Deadlines::removeAt(int index) {
+  int slot = heap[index];
+  count--;
+  if (index != count) {
+    swap(index, count);
+    siftDown(index);
+    siftUp(index);
+  }
+  position[slot] = 0;
+}
+
+// **************************** Implementation of the Deadlines API ***************************************************
+long long Deadlines::now() {
+  struct timespec time{};
+  clock_gettime(CLOCK_MONOTONIC, &time);
+  return time.tv_sec * NSECS_PER_SEC + time.tv_nsec;
+}
+
+long long Deadlines::after(long usecs) {
+  return now() + usecs * 1000LL;
+}
+
+long long Deadlines::fromTimespec(const struct timespec* time) {
+  return time->tv_sec * NSECS_PER_SEC + time->tv_nsec;
+}
+
+bool Deadlines::empty() {
+  return count == 0;
+}
+
+// The earliest deadline, 0 if there is none.
+long long Deadlines::earliest() {
+  return count == 0 ? 0 : when[heap[0]];
+}
+
+bool Deadlines::contains(int slot) {
+  return position[slot] != 0;
+}
+
+// Adds or moves the slot's deadline and arms the timer if it is now the earliest.
+void Deadlines::set(int slot, long long deadline) {
+  if (position[slot] == 0) {
+    heap[count++] = slot;
+    position[slot] = count;
+  }
+  when[slot] = deadline;
+  siftDown(position[slot] - 1);
+  siftUp(position[slot] - 1);
+  arm();
+}
+
+// The timer stays armed: an early expiry only costs a spurious wakeup, cheaper than a timerfd_settime each time a
+// wait ends before its deadline.
+void Deadlines::cancel(int slot) {
+  if (position[slot] != 0) {
+    removeAt(position[slot] - 1);
+  }
+}
+
+// Removes and returns a slot whose deadline is at or before time, or returns -1 if there is none.
+int Deadlines::popExpired(long long time) {
+  if (count == 0 || when[heap[0]] > time) {
+    return -1;
+  }
+  int slot = heap[0];
+  removeAt(0);
+  return slot;
+}
+
+// Makes sure the timerfd fires no later than the earliest deadline. The timerfd is created, and handed to the
+// poller, on the first deadline.
+void Deadlines::arm() {
+  if (count == 0) {
+    return;
+  }
+  long long next = when[heap[0]];
+  if (armed != 0 && armed <= next) {
+    return;
+  }
+  if (timerFd == -1) {
+    timerFd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (timerFd == -1) {
+      std::cerr << "system error: cannot create deadline timer" << std::endl;
+      exit(1);
+    }
+    Poller::watch(timerFd);
+  }
+  struct itimerspec spec{};
+  spec.it_value.tv_sec = next / NSECS_PER_SEC;
+  spec.it_value.tv_nsec = next % NSECS_PER_SEC;
+  if (timerfd_settime(timerFd, TFD_TIMER_ABSTIME, &spec, nullptr) == -1) {
+    std::cerr << "system error: cannot arm deadline timer" << std::endl;
+    exit(1);
+  }
+  armed = next;
+}
+
+int Deadlines::fd() {
+  return timerFd;
+}
+
+// Called by the poller when the timerfd fired. The next arm() sets it again for whatever is earliest by then.
+void Deadlines::acknowledge() {
+  uint64_t expirations;
+  while (read(timerFd, &expirations, sizeof(expirations)) == -1 && errno == EINTR) {
+  }
+  armed = 0;
+}
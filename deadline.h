@@ -0,0 +1,45 @@
+//
+// Wall-clock deadlines on CLOCK_MONOTONIC, in nanoseconds. One indexed min-heap holds every pending deadline, keyed
+// by a small slot number (the thread ID for sleeps and timed waits, past the thread IDs for timers), and a timerfd
+// armed to the earliest one ends the scheduler's idle wait right on time. While threads are running, due deadlines
+// are picked up at the next tick.
+//
+
+#ifndef _DEADLINE_H_
+#define _DEADLINE_H_
+
+#include "uthreads.h"
+
+#define DEADLINE_SLOTS (MAX_THREAD_NUM + UTHREAD_MAX_TIMERS)   /* one deadline per thread and per timer */
+
+class Deadlines {
+private:
+    static void swap(int a, int b);
+    static void siftUp(int index);
+    static void siftDown(int index);
+    static void removeAt(int index);
+
+    static long long when[DEADLINE_SLOTS];
+    static int heap[DEADLINE_SLOTS];        // slots, earliest deadline first
+    static int position[DEADLINE_SLOTS];    // index of each slot in heap plus one, 0 when it has no deadline
+    static int count;
+    static int timerFd;
+    static long long armed;                 // deadline the timerfd is set to, 0 once it fired or was never set
+
+public:
+    static long long now();
+    static long long after(long usecs);
+    static long long fromTimespec(const struct timespec* time);
+
+    static bool empty();
+    static long long earliest();
+    static bool contains(int slot);
+    static void set(int slot, long long deadline);
+    static void cancel(int slot);
+    static int popExpired(long long time);
+    static void arm();
+    static int fd();
+    static void acknowledge();
+};
+
+#endif //_DEADLINE_H_
@@ -0,0 +1,55 @@
+#include "futex.h"
+#include "scheduler.h"
+#include "waitqueue.h"
+#include <cstdint>
+
+// Static variables initialization
+uthread_waitq_t Futex::buckets[FUTEX_BUCKETS];
+
+//************************* Implementation of the private functions ****************************************************
+// Fibonacci hashing of the word address spreads neighbouring ints over different buckets.
+uthread_waitq_t* Futex::bucketOf(const int* addr) {
+  uint64_t word = reinterpret_cast<uintptr_t>(addr) / sizeof(int);
+  return &buckets[(word * 0x9E3779B97F4A7C15ULL) >> (64 - FUTEX_BUCKET_BITS)];
+}
+
+// **************************** Implementation of the Futex API *******************************************************
+// Returns 0 once woken, 1 without waiting if *addr no longer holds expected, and 2 if the timeout or the deadline
+// expired. The comparison and the enqueue happen in one critical section, so a wake that follows a change of *addr
+// can never be missed.
+int Futex::wait(int* addr, int expected, int timeoutQuantums, long long deadline) {
+  Scheduler::blockTimerSignal();
+  if (__atomic_load_n(addr, __ATOMIC_ACQUIRE) != expected) {
+    Scheduler::unblockTimerSignal();
+    return 1;
+  }
+  uthread_waiter& waiter = *Scheduler::takeWaiters(1);
+  waiter.data = addr;
+  Scheduler::addWaiter(bucketOf(addr), &waiter);
+  if (Scheduler::parkCurrent(timeoutQuantums, deadline) < 0) {
+    return -1;
+  }
+  return waiter.result == WAIT_TIMEDOUT ? 2 : 0;
+}
+
+// Wakes up to count threads waiting on addr, longest waiting first. Returns how many were woken.
+int Futex::wake(int* addr, int count) {
+  Scheduler::blockTimerSignal();
+  uthread_waitq_t* bucket = bucketOf(addr);
+  int woken = 0;
+  uthread_waiter* prev = nullptr;
+  uthread_waiter* waiter = bucket->head;
+  while (waiter != nullptr && woken < count) {
+    uthread_waiter* next = waiter->next;
+    if (waiter->data == addr) {
+      WaitQueue::unlink(bucket, prev, waiter);
+      Scheduler::unpark(waiter);
+      woken++;
+    } else {
+      prev = waiter;
+    }
+    waiter = next;
+  }
+  Scheduler::unblockTimerSignal();
+  return woken;
+}
@@ -0,0 +1,25 @@
+//
+// Wait-on-address: threads park on an int until another thread changes it and wakes them, like a Linux futex.
+//
+
+#ifndef _FUTEX_H_
+#define _FUTEX_H_
+
+#include "uthreads.h"
+
+#define FUTEX_BUCKET_BITS 6
+#define FUTEX_BUCKETS (1 << FUTEX_BUCKET_BITS)  /* wait queues addresses are hashed to */
+
+class Futex {
+private:
+    static uthread_waitq_t* bucketOf(const int* addr);
+
+    // Waiters of every address in a bucket share one queue; waiter data holds the address each one waits on.
+    static uthread_waitq_t buckets[FUTEX_BUCKETS];
+
+public:
+    static int wait(int* addr, int expected, int timeoutQuantums, long long deadline = 0);
+    static int wake(int* addr, int count);
+};
+
+#endif //_FUTEX_H_
@@ -0,0 +1,76 @@
+#include "keys.h"
+#include "scheduler.h"
+#include "thread.h"
+#include <iostream>
+
+// Rounds of destructor calls at exit, as destructors may set values again (PTHREAD_DESTRUCTOR_ITERATIONS).
+#define DESTRUCTOR_ROUNDS 4
+
+Key Keys::keys[UTHREAD_KEYS_MAX];
+
+int Keys::create(uthread_key_t* key, uthread_key_destructor destructor) {
+  Scheduler::blockTimerSignal();
+  for (int i = 0; i < UTHREAD_KEYS_MAX; i++) {
+    if (!keys[i].used) {
+      keys[i].used = true;
+      keys[i].destructor = destructor;
+      *key = i;
+      Scheduler::unblockTimerSignal();
+      return 0;
+    }
+  }
+  Scheduler::unblockTimerSignal();
+  std::cerr << "thread library error: no more keys available" << std::endl;
+  return -1;
+}
+
+// The key's values are dropped without calling its destructor, so a key created later starts out null everywhere.
+int Keys::remove(uthread_key_t key) {
+  Scheduler::blockTimerSignal();
+  if (!keys[key].used) {
+    Scheduler::unblockTimerSignal();
+    std::cerr << "thread library error: key " << key << " is not in use" << std::endl;
+    return -1;
+  }
+  keys[key].used = false;
+  keys[key].destructor = nullptr;
+  Scheduler::clearKey(key);
+  Scheduler::unblockTimerSignal();
+  return 0;
+}
+
+// Runs with the timer signal unblocked: a switch in between resumes this thread with the same Thread current.
+void* Keys::get(uthread_key_t key) {
+  return Scheduler::currentThread()->getSpecific()[key];
+}
+
+int Keys::set(uthread_key_t key, const void* value) {
+  if (!keys[key].used) {
+    std::cerr << "thread library error: key " << key << " is not in use" << std::endl;
+    return -1;
+  }
+  Scheduler::currentThread()->getSpecific()[key] = const_cast<void*>(value);
+  return 0;
+}
+
+// Called on the exiting thread itself, before it gives up its stack, so destructors may use uthread_ functions.
+void Keys::runDestructors(Thread* thread) {
+  void** specific = thread->getSpecific();
+  for (int round = 0; round < DESTRUCTOR_ROUNDS; round++) {
+    bool called = false;
+    for (int i = 0; i < UTHREAD_KEYS_MAX; i++) {
+      void* value = specific[i];
+      if (value == nullptr) {
+        continue;
+      }
+      specific[i] = nullptr;
+      if (keys[i].used && keys[i].destructor != nullptr) {
+        keys[i].destructor(value);
+        called = true;
+      }
+    }
+    if (!called) {
+      return;
+    }
+  }
+}
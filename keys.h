@@ -0,0 +1,31 @@
+//
+// Thread-local keys, like pthread_key_create. Each thread keeps its values in an array in its Thread, indexed by the
+// key, and the scheduler keeps a pointer to the RUNNING Thread up to date at every switch, so reading a value is a
+// couple of loads with no lookup by tid and no signal masking.
+//
+
+#ifndef _KEYS_H_
+#define _KEYS_H_
+
+#include "uthreads.h"
+
+class Thread;
+
+struct Key {
+    bool used;
+    uthread_key_destructor destructor;
+};
+
+class Keys {
+private:
+    static Key keys[UTHREAD_KEYS_MAX];
+
+public:
+    static int create(uthread_key_t* key, uthread_key_destructor destructor);
+    static int remove(uthread_key_t key);
+    static void* get(uthread_key_t key);
+    static int set(uthread_key_t key, const void* value);
+    static void runDestructors(Thread* thread);
+};
+
+#endif //_KEYS_H_
@@ -37,7 +37,8 @@ int main() {
     std::cout << "Main: spawn returned " << childTid << std::endl;
     assert(childTid == 1);
 
-    // 4) When child finishes, we're back here
+    // 4) Park until the child finishes
+    assert(uthread_join(childTid, nullptr) == 0);
     std::cout << "Main: back after child termination" << std::endl;
 
     // 5) Inspect total quantums so far
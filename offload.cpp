@@ -0,0 +1,142 @@
+#include "offload.h"
+#include "scheduler.h"
+#include "poller.h"
+#include "waitqueue.h"
+#include <cerrno>
+#include <csignal>
+#include <cstdint>
+#include <iostream>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+// Static variables initialization
+pthread_mutex_t Offload::lock = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t Offload::work = PTHREAD_COND_INITIALIZER;
+OffloadRequest* Offload::queueHead = nullptr;
+OffloadRequest* Offload::queueTail = nullptr;
+int Offload::helpers = 0;
+int Offload::idleHelpers = 0;
+std::atomic<OffloadRequest*> Offload::completed(nullptr);
+int Offload::eventFd = -1;
+int Offload::pending = 0;
+
+//************************* Implementation of the private functions ****************************************************
+// Helpers are started with the timer signal blocked and keep it blocked: it belongs to the carrier.
+void* Offload::helperMain(void*) {
+  pthread_mutex_lock(&lock);
+  while (true) {
+    idleHelpers++;
+    while (queueHead == nullptr) {
+      pthread_cond_wait(&work, &lock);
+    }
+    idleHelpers--;
+    OffloadRequest* request = queueHead;
+    queueHead = request->next;
+    if (queueHead == nullptr) {
+      queueTail = nullptr;
+    }
+    pthread_mutex_unlock(&lock);
+
+    errno = 0;
+    request->result.value = request->fn(request->arg);
+    request->result.error = errno;
+    request->next = completed.load(std::memory_order_relaxed);
+    while (!completed.compare_exchange_weak(request->next, request, std::memory_order_release,
+                                            std::memory_order_relaxed)) {
+    }
+    uint64_t one = 1;
+    while (write(eventFd, &one, sizeof(one)) == -1 && errno == EINTR) {
+    }
+
+    pthread_mutex_lock(&lock);
+  }
+}
+
+// **************************** Implementation of the Offload API *****************************************************
+int Offload::fd() {
+  return eventFd;
+}
+
+bool Offload::hasWaiters() {
+  return pending > 0;
+}
+
+// Resumes the threads whose calls finished. Called by the poller when the eventfd is readable. Timer signal blocked.
+void Offload::drain() {
+  uint64_t count;
+  while (read(eventFd, &count, sizeof(count)) == -1 && errno == EINTR) {
+  }
+  OffloadRequest* request = completed.exchange(nullptr, std::memory_order_acquire);
+  while (request != nullptr) {
+    OffloadRequest* next = request->next;
+    uthread_waiter* waiter = WaitQueue::pop(&request->waiters);
+    if (waiter != nullptr) {
+      *static_cast<OffloadResult*>(Scheduler::waiterData(waiter)) = request->result;
+      Scheduler::unpark(waiter);
+    }
+    pending--;
+    delete request;
+    request = next;
+  }
+}
+
+int Offload::run(thread_routine fn, void* arg, void** result) {
+  Scheduler::blockTimerSignal();
+  if (eventFd == -1) {
+    eventFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (eventFd == -1) {
+      std::cerr << "system error: cannot create offload eventfd" << std::endl;
+      exit(1);
+    }
+    Poller::watch(eventFd);
+  }
+  auto* request = new(std::nothrow) OffloadRequest();
+  if (request == nullptr) {
+    std::cerr << "system error: cannot allocate offload request" << std::endl;
+    exit(1);
+  }
+  request->fn = fn;
+  request->arg = arg;
+  WaitQueue::init(&request->waiters);
+
+  pthread_mutex_lock(&lock);
+  if (queueTail != nullptr) {
+    queueTail->next = request;
+  } else {
+    queueHead = request;
+  }
+  queueTail = request;
+  if (idleHelpers == 0 && helpers < OFFLOAD_THREADS) {
+    // Helpers block every signal, so none is ever delivered to a thread outside the scheduler.
+    sigset_t all, old;
+    sigfillset(&all);
+    pthread_sigmask(SIG_SETMASK, &all, &old);
+    pthread_t thread;
+    if (pthread_create(&thread, nullptr, helperMain, nullptr) != 0) {
+      std::cerr << "system error: cannot create offload thread" << std::endl;
+      exit(1);
+    }
+    pthread_sigmask(SIG_SETMASK, &old, nullptr);
+    pthread_detach(thread);
+    helpers++;
+  } else {
+    pthread_cond_signal(&work);
+  }
+  pthread_mutex_unlock(&lock);
+  pending++;
+
+  // Completions are only drained with the timer signal blocked on this carrier, so this one cannot be missed
+  // before the thread is parked.
+  OffloadResult outcome{};
+  uthread_waiter& waiter = *Scheduler::takeWaiters(1);
+  waiter.data = &outcome;
+  Scheduler::addWaiter(&request->waiters, &waiter);
+  if (Scheduler::parkCurrent(0) < 0) {
+    return -1;
+  }
+  if (result != nullptr) {
+    *result = outcome.value;
+  }
+  errno = outcome.error;
+  return 0;
+}
@@ -0,0 +1,55 @@
+//
+// Offload pool for blocking calls that have no non-blocking form, such as fsync or open on a slow filesystem. The
+// calling uthread parks while a helper pthread runs the call. The helper posts the finished request on a completion
+// list and signals an eventfd the poller watches, so the scheduler resumes the uthread at its next polling round
+// and keeps running the others meanwhile.
+//
+
+#ifndef _OFFLOAD_H_
+#define _OFFLOAD_H_
+
+#include "uthreads.h"
+#include <pthread.h>
+#include <atomic>
+
+#define OFFLOAD_THREADS 4   /* helper pthreads, started as requests find none idle */
+
+// What the helper hands back to the parked thread.
+struct OffloadResult {
+    void* value;
+    int error;              // errno as the function left it
+};
+
+// Allocated per call rather than on the caller's stack, so a helper finishing after its caller was terminated
+// writes to memory that is still there.
+struct OffloadRequest {
+    thread_routine fn;
+    void* arg;
+    OffloadResult result;
+    OffloadRequest* next;           // pending queue, then completion list
+    uthread_waitq_t waiters;
+};
+
+class Offload {
+private:
+    static void* helperMain(void* arg);
+
+    // Plain pthread objects, like SysMon's: helpers may still be waiting on them at process exit.
+    static pthread_mutex_t lock;
+    static pthread_cond_t work;
+    static OffloadRequest* queueHead;
+    static OffloadRequest* queueTail;
+    static int helpers;
+    static int idleHelpers;
+    static std::atomic<OffloadRequest*> completed;
+    static int eventFd;
+    static int pending;
+
+public:
+    static int fd();
+    static bool hasWaiters();
+    static void drain();
+    static int run(thread_routine fn, void* arg, void** result);
+};
+
+#endif //_OFFLOAD_H_
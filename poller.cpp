@@ -0,0 +1,384 @@
+#include "poller.h"
+#include "scheduler.h"
+#include "waitqueue.h"
+#include "uring.h"
+#include "offload.h"
+#include "deadline.h"
+#include "signals.h"
+#include <cerrno>
+#include <fcntl.h>
+#include <iostream>
+#include <sys/epoll.h>
+#include <sys/sendfile.h>
+#include <unistd.h>
+
+// Every function touching the entries runs with the timer signal blocked; the I/O calls themselves do not.
+
+// Static variables initialization
+int Poller::epollFd = -1;
+PollEntry Poller::entries[UTHREAD_MAX_FDS];
+int Poller::entryLimit = 0;
+bool Poller::useUring = false;
+
+//************************* Implementation of the private functions ****************************************************
+// The epoll instance, created on first use. Timer signal blocked.
+int Poller::instance() {
+  if (epollFd == -1) {
+    epollFd = epoll_create1(EPOLL_CLOEXEC);
+    if (epollFd == -1) {
+      std::cerr << "system error: cannot create epoll instance" << std::endl;
+      exit(1);
+    }
+  }
+  return epollFd;
+}
+
+// The entry of a registered descriptor, or null. Timer signal blocked.
+PollEntry* Poller::find(int fd) {
+  if (fd < 0 || fd >= entryLimit || !entries[fd].registered) {
+    return nullptr;
+  }
+  return &entries[fd];
+}
+
+// Switches a descriptor the library has not seen yet to non-blocking mode and registers it with epoll.
+PollEntry* Poller::prepare(int fd) {
+  if (fd >= UTHREAD_MAX_FDS) {
+    std::cerr << "thread library error: file descriptor beyond UTHREAD_MAX_FDS" << std::endl;
+    errno = EBADF;
+    return nullptr;
+  }
+  Scheduler::blockTimerSignal();
+  PollEntry* found = find(fd);
+  if (found != nullptr) {
+    Scheduler::unblockTimerSignal();
+    return found;
+  }
+  int flags = fcntl(fd, F_GETFL);
+  if (flags == -1 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) == -1) {
+    Scheduler::unblockTimerSignal();
+    return nullptr;
+  }
+  struct epoll_event event{};
+  event.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+  event.data.fd = fd;
+  // Regular files cannot be polled (EPERM); they never block, so they simply never park.
+  if (epoll_ctl(instance(), EPOLL_CTL_ADD, fd, &event) == -1 && errno != EPERM) {
+    Scheduler::unblockTimerSignal();
+    return nullptr;
+  }
+  PollEntry& entry = entries[fd];
+  WaitQueue::init(&entry.readers);
+  WaitQueue::init(&entry.writers);
+  entry.readEdges = 0;
+  entry.writeEdges = 0;
+  entry.registered = true;
+  if (fd >= entryLimit) {
+    entryLimit = fd + 1;
+  }
+  Scheduler::unblockTimerSignal();
+  return &entry;
+}
+
+// Sampled before each I/O attempt. Looked up again each time since another thread may close the descriptor.
+unsigned Poller::edges(int fd, bool writing) {
+  Scheduler::blockTimerSignal();
+  PollEntry* found = find(fd);
+  unsigned seen = found == nullptr ? 0 : writing ? found->writeEdges : found->readEdges;
+  Scheduler::unblockTimerSignal();
+  return seen;
+}
+
+// Parks the running thread until the descriptor becomes readable or writable, unless an edge was collected since
+// seen was sampled, in which case the caller retries right away.
+int Poller::waitFor(int fd, bool writing, unsigned seen) {
+  Scheduler::blockTimerSignal();
+  PollEntry* found = find(fd);
+  if (found == nullptr) {
+    Scheduler::unblockTimerSignal();
+    errno = EBADF;
+    return -1;
+  }
+  if ((writing ? found->writeEdges : found->readEdges) != seen) {
+    Scheduler::unblockTimerSignal();
+    return 0;
+  }
+  uthread_waiter& waiter = *Scheduler::takeWaiters(1);
+  Scheduler::addWaiter(writing ? &found->writers : &found->readers, &waiter);
+  if (Scheduler::parkCurrent(0) < 0) {
+    return -1;
+  }
+  if (waiter.result == WAIT_CLOSED) {
+    errno = EBADF;
+    return -1;
+  }
+  return 0;
+}
+
+// For transfers between two descriptors, either of which may be the one that is not ready: parks on both, and the
+// first edge on either side retries the transfer.
+int Poller::waitForEither(int inFd, unsigned seenIn, int outFd, unsigned seenOut) {
+  Scheduler::blockTimerSignal();
+  PollEntry* in = find(inFd);
+  PollEntry* out = find(outFd);
+  if (in == nullptr || out == nullptr) {
+    Scheduler::unblockTimerSignal();
+    errno = EBADF;
+    return -1;
+  }
+  if (in->readEdges != seenIn || out->writeEdges != seenOut) {
+    Scheduler::unblockTimerSignal();
+    return 0;
+  }
+  uthread_waiter* waiters = Scheduler::takeWaiters(2);
+  uthread_waiter& readWaiter = waiters[0];
+  uthread_waiter& writeWaiter = waiters[1];
+  Scheduler::addWaiter(&in->readers, &readWaiter);
+  Scheduler::addWaiter(&out->writers, &writeWaiter);
+  if (Scheduler::parkCurrent(0) < 0) {
+    return -1;
+  }
+  if (readWaiter.result == WAIT_CLOSED || writeWaiter.result == WAIT_CLOSED) {
+    errno = EBADF;
+    return -1;
+  }
+  return 0;
+}
+
+// **************************** Implementation of the Poller API ******************************************************
+// Returns the backend now in use, which is epoll when io_uring was asked for but the kernel does not offer it.
+int Poller::setBackend(int backend) {
+  Scheduler::blockTimerSignal();
+  if (hasWaiters()) {
+    std::cerr << "thread library error: cannot switch the I/O backend while threads wait for I/O" << std::endl;
+    Scheduler::unblockTimerSignal();
+    return -1;
+  }
+  bool started = Uring::fd() != -1;
+  if (backend == UTHREAD_IO_URING && Uring::start()) {
+    if (!started) {
+      // The ring polls readable while completions wait.
+      watch(Uring::fd());
+    }
+    useUring = true;
+  } else {
+    useUring = false;
+  }
+  Scheduler::unblockTimerSignal();
+  return useUring ? UTHREAD_IO_URING : UTHREAD_IO_EPOLL;
+}
+
+// Adds one of the library's own completion descriptors, level-triggered, so that it ends the idle wait. Timer
+// signal blocked.
+void Poller::watch(int fd) {
+  struct epoll_event event{};
+  event.events = EPOLLIN;
+  event.data.fd = fd;
+  if (epoll_ctl(instance(), EPOLL_CTL_ADD, fd, &event) == -1) {
+    std::cerr << "system error: cannot watch a completion descriptor" << std::endl;
+    exit(1);
+  }
+}
+
+// The epoll descriptor itself, readable whenever a poll would find something to do.
+int Poller::fd() {
+  return instance();
+}
+
+bool Poller::hasWaiters() {
+  if (Uring::hasWaiters() || Offload::hasWaiters() || Signals::hasWaiters()) {
+    return true;
+  }
+  for (int fd = 0; fd < entryLimit; fd++) {
+    PollEntry& entry = entries[fd];
+    if (entry.registered && (!WaitQueue::empty(&entry.readers) || !WaitQueue::empty(&entry.writers))) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// One polling round: submits the io_uring operations queued since the last round, then collects ready descriptors
+// and completions and makes the threads waiting for them READY. Timer signal blocked.
+void Poller::poll(int timeoutMs) {
+  Uring::submit();
+  if (Uring::reap() > 0) {
+    timeoutMs = 0;
+  }
+  if (epollFd == -1 && timeoutMs == 0) {
+    return;
+  }
+  // An idle wait needs the instance even with nothing registered, or it would not wait at all.
+  struct epoll_event events[POLLER_BATCH];
+  int count = epoll_wait(instance(), events, POLLER_BATCH, timeoutMs);
+  for (int i = 0; i < count; i++) {
+    if (events[i].data.fd == Uring::fd()) {
+      Uring::reap();
+      continue;
+    }
+    if (events[i].data.fd == Offload::fd()) {
+      Offload::drain();
+      continue;
+    }
+    if (events[i].data.fd == Signals::fd()) {
+      Signals::drain();
+      continue;
+    }
+    if (events[i].data.fd == Deadlines::fd()) {
+      Deadlines::acknowledge(); // the scheduler wakes the sleepers right after polling
+      continue;
+    }
+    PollEntry* found = find(events[i].data.fd);
+    if (found == nullptr) {
+      continue;
+    }
+    uint32_t ready = events[i].events;
+    // Errors and hangups wake both sides, so the retried call reports them.
+    if (ready & (EPOLLIN | EPOLLRDHUP | EPOLLERR | EPOLLHUP)) {
+      found->readEdges++;
+      Scheduler::unparkAll(&found->readers, WAIT_WOKEN);
+    }
+    if (ready & (EPOLLOUT | EPOLLERR | EPOLLHUP)) {
+      found->writeEdges++;
+      Scheduler::unparkAll(&found->writers, WAIT_WOKEN);
+    }
+  }
+}
+
+// With io_uring, a descriptor that is non-blocking, like one the epoll backend already used, fails with EAGAIN
+// instead of waiting and goes through epoll instead.
+ssize_t Poller::read(int fd, void* buf, size_t count) {
+  if (useUring) {
+    ssize_t result = Uring::read(fd, buf, count, -1);
+    if (result >= 0 || errno != EAGAIN) {
+      return result;
+    }
+  }
+  if (prepare(fd) == nullptr) {
+    return -1;
+  }
+  while (true) {
+    unsigned seen = edges(fd, false);
+    ssize_t result = ::read(fd, buf, count);
+    if (result >= 0 || (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)) {
+      return result;
+    }
+    if (errno != EINTR && waitFor(fd, false, seen) < 0) {
+      return -1;
+    }
+  }
+}
+
+ssize_t Poller::write(int fd, const void* buf, size_t count) {
+  if (useUring) {
+    ssize_t result = Uring::write(fd, buf, count, -1);
+    if (result >= 0 || errno != EAGAIN) {
+      return result;
+    }
+  }
+  if (prepare(fd) == nullptr) {
+    return -1;
+  }
+  while (true) {
+    unsigned seen = edges(fd, true);
+    ssize_t result = ::write(fd, buf, count);
+    if (result >= 0 || (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)) {
+      return result;
+    }
+    if (errno != EINTR && waitFor(fd, true, seen) < 0) {
+      return -1;
+    }
+  }
+}
+
+// Accepted sockets are created non-blocking for epoll and blocking for io_uring, ready for uthread_read and
+// uthread_write either way.
+int Poller::accept(int fd, struct sockaddr* addr, socklen_t* addrlen) {
+  if (useUring) {
+    int result = Uring::accept(fd, addr, addrlen);
+    if (result >= 0 || errno != EAGAIN) {
+      return result;
+    }
+  }
+  if (prepare(fd) == nullptr) {
+    return -1;
+  }
+  while (true) {
+    unsigned seen = edges(fd, false);
+    int result = ::accept4(fd, addr, addrlen, SOCK_NONBLOCK | SOCK_CLOEXEC);
+    if (result >= 0 || (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)) {
+      return result;
+    }
+    if (errno != EINTR && waitFor(fd, false, seen) < 0) {
+      return -1;
+    }
+  }
+}
+
+// The data moves inside the kernel, so serving a large file needs no buffer on the thread's stack. Both descriptors
+// go through epoll whatever the backend, io_uring having no sendfile.
+ssize_t Poller::sendfile(int outFd, int inFd, off_t* offset, size_t count) {
+  if (prepare(inFd) == nullptr || prepare(outFd) == nullptr) {
+    return -1;
+  }
+  while (true) {
+    unsigned seenIn = edges(inFd, false);
+    unsigned seenOut = edges(outFd, true);
+    ssize_t result = ::sendfile(outFd, inFd, offset, count);
+    if (result >= 0 || (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)) {
+      return result;
+    }
+    if (errno != EINTR && waitForEither(inFd, seenIn, outFd, seenOut) < 0) {
+      return -1;
+    }
+  }
+}
+
+// SPLICE_F_NONBLOCK keeps the pipe end from blocking even when the caller's pipe is in blocking mode.
+ssize_t Poller::splice(int inFd, loff_t* inOffset, int outFd, loff_t* outOffset, size_t length, unsigned flags) {
+  if (prepare(inFd) == nullptr || prepare(outFd) == nullptr) {
+    return -1;
+  }
+  while (true) {
+    unsigned seenIn = edges(inFd, false);
+    unsigned seenOut = edges(outFd, true);
+    ssize_t result = ::splice(inFd, inOffset, outFd, outOffset, length, flags | SPLICE_F_NONBLOCK);
+    if (result >= 0 || (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)) {
+      return result;
+    }
+    if (errno != EINTR && waitForEither(inFd, seenIn, outFd, seenOut) < 0) {
+      return -1;
+    }
+  }
+}
+
+// Positioned I/O is for files, which epoll cannot wait on and which never report EAGAIN, so without io_uring it is
+// a plain call.
+ssize_t Poller::pread(int fd, void* buf, size_t count, off_t offset) {
+  if (useUring) {
+    return Uring::read(fd, buf, count, offset);
+  }
+  return ::pread(fd, buf, count, offset);
+}
+
+ssize_t Poller::pwrite(int fd, const void* buf, size_t count, off_t offset) {
+  if (useUring) {
+    return Uring::write(fd, buf, count, offset);
+  }
+  return ::pwrite(fd, buf, count, offset);
+}
+
+// Threads still parked on the descriptor fail with EBADF instead of waiting forever.
+int Poller::close(int fd) {
+  Scheduler::blockTimerSignal();
+  Uring::cancel(fd);
+  PollEntry* found = find(fd);
+  if (found != nullptr) {
+    Scheduler::unparkAll(&found->readers, WAIT_CLOSED);
+    Scheduler::unparkAll(&found->writers, WAIT_CLOSED);
+    epoll_ctl(epollFd, EPOLL_CTL_DEL, fd, nullptr);
+    found->registered = false;
+  }
+  Scheduler::unblockTimerSignal();
+  return ::close(fd);
+}
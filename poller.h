@@ -0,0 +1,58 @@
+//
+// Epoll-based I/O poller. A uthread whose non-blocking I/O would block parks on the file descriptor, and the
+// scheduler polls for readiness once per quantum and whenever nothing is READY. With the io_uring backend selected,
+// reads, writes and accepts go through the ring instead, and the same polling rounds submit and reap them.
+//
+
+#ifndef _POLLER_H_
+#define _POLLER_H_
+
+#include "uthreads.h"
+#include <sys/types.h>
+#include <sys/socket.h>
+
+#define POLLER_BATCH 64     /* events collected per epoll_wait */
+
+// Threads parked on one file descriptor. The descriptor is registered edge-triggered for both directions once, on
+// first use, so parking never needs an epoll_ctl. The edge counts let a thread notice an edge that was collected
+// between its failed attempt and parking, which edge-triggered epoll would not report again.
+struct PollEntry {
+    uthread_waitq_t readers;
+    uthread_waitq_t writers;
+    unsigned readEdges;
+    unsigned writeEdges;
+    bool registered;
+};
+
+class Poller {
+private:
+    static int instance();
+    static PollEntry* find(int fd);
+    static PollEntry* prepare(int fd);
+    static unsigned edges(int fd, bool writing);
+    static int waitFor(int fd, bool writing, unsigned seen);
+    static int waitForEither(int inFd, unsigned seenIn, int outFd, unsigned seenOut);
+
+    static int epollFd;
+    static PollEntry entries[UTHREAD_MAX_FDS];    // by descriptor, so registering one never allocates
+    static int entryLimit;                         // one past the highest descriptor registered so far
+    static bool useUring;
+
+public:
+    static int setBackend(int backend);
+    static void watch(int fd);
+    static int fd();
+    static bool hasWaiters();
+    static void poll(int timeoutMs);
+
+    static ssize_t read(int fd, void* buf, size_t count);
+    static ssize_t write(int fd, const void* buf, size_t count);
+    static ssize_t pread(int fd, void* buf, size_t count, off_t offset);
+    static ssize_t pwrite(int fd, const void* buf, size_t count, off_t offset);
+    static int accept(int fd, struct sockaddr* addr, socklen_t* addrlen);
+    static ssize_t sendfile(int outFd, int inFd, off_t* offset, size_t count);
+    static ssize_t splice(int inFd, loff_t* inOffset, int outFd, loff_t* outOffset, size_t length, unsigned flags);
+    static int close(int fd);
+};
+
+#endif //_POLLER_H_
@@ -4,37 +4,247 @@
 
 #include "scheduler.h"
 #include "uthreads.h"
+#include "sysmon.h"
+#include "sync.h"
+#include "poller.h"
+#include "deadline.h"
+#include "timer.h"
+#include "signals.h"
+#include "keys.h"
 #include <iostream>
+#include <algorithm>
 #include <sys/time.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+// Upper bound on consecutive dispatches of affine-woken threads, so two threads waking each other cannot keep
+// jumping the READY queue and starve everyone queued behind them.
+#define WAKE_AFFINE_MAX_STREAK 4
+
+// Pass increment of a group with one share; a group with N shares advances N times slower.
+#define GROUP_STRIDE (1L << 20)
 
 Scheduler scheduler;
 // Static variables initialization
 int Scheduler::quantumUsecs = 0;
 int Scheduler::totalQuantums = 0;
 int Scheduler::currentTid = 0;
+Thread* Scheduler::current = nullptr;
+thread_local char* Scheduler::carrierStack = nullptr;
+thread_local size_t Scheduler::carrierStackSize = 0;
+thread_local stack_t Scheduler::carrierSignalStack = {};
 int Scheduler::pendingDeletionTid = -1;
-std::unordered_map<int, Thread*> Scheduler::threads;
-std::queue<int> Scheduler::readyQueue;
+Thread* Scheduler::threads[MAX_THREAD_NUM];
+std::deque<int> Scheduler::readyQueue;
 std::unordered_map<int, int> Scheduler::sleepingThreads;
+void* Scheduler::exitValues[MAX_THREAD_NUM];
+bool Scheduler::exited[MAX_THREAD_NUM];
+int Scheduler::wakeAffineWindow = 0;
+int Scheduler::affineStreak = 0;
+int Scheduler::affineWakeups = 0;
+int Scheduler::tailWakeups = 0;
+int Scheduler::prioritizedThreads = 0;
+std::unordered_map<int, ThreadGroup> Scheduler::groups;
+int Scheduler::gangGroup = -1;
+long Scheduler::groupVirtualTime = 0;
+bool Scheduler::embedded = false;
+bool Scheduler::hostWaiting = false;
+long long Scheduler::hostDeadline = 0;
 
 //************************* Implementation of the private functions ****************************************************
+// Callers hold the timer signal blocked.
 void Scheduler::removeFromReadyQueue(int tid) {
-  blockTimerSignal();
-  std::queue<int> tempQueue;
-  while (!readyQueue.empty()) {
-    int current = readyQueue.front();
-    readyQueue.pop();
-    if (current != tid) {
-      tempQueue.push(current);
+  readyQueue.erase(std::remove(readyQueue.begin(), readyQueue.end(), tid), readyQueue.end());
+}
+
+// Moves a woken thread to READY. A thread that ran recently enough to still be cache-warm goes to the head of the
+// queue (wake-affine), anything else to the tail. runNext asks for the head regardless of the window, for a thread
+// that was just handed data it will consume right away. Callers hold the timer signal blocked.
+void Scheduler::makeReady(int tid, bool runNext) {
+  Thread* thread = threads[tid];
+  thread->setState(READY);
+  bool warm = thread->getQuantumCount() > 0 &&
+              totalQuantums - thread->getLastRunQuantum() <= wakeAffineWindow;
+  if ((runNext || (wakeAffineWindow > 0 && warm)) && affineStreak < WAKE_AFFINE_MAX_STREAK) {
+    thread->setWokenAffine(true);
+    readyQueue.push_front(tid);
+    affineWakeups++;
+    return;
+  }
+  thread->setWokenAffine(false);
+  readyQueue.push_back(tid);
+  tailWakeups++;
+}
+
+// Pops the next thread to run. Callers hold the timer signal blocked and have checked the queue is not empty.
+int Scheduler::pickNextTid() {
+  auto pos = prioritizedThreads > 0 ? pickByPriority() : readyQueue.end();
+  if (pos == readyQueue.end()) {
+    pos = groups.empty() ? readyQueue.begin() : pickGroupAware();
+  }
+  int tid = *pos;
+  readyQueue.erase(pos);
+  Thread* thread = threads[tid];
+  if (thread->isWokenAffine()) {
+    thread->setWokenAffine(false);
+    affineStreak++;
+  } else {
+    affineStreak = 0;
+  }
+  if (thread->getGroupId() != -1) {
+    chargeGroup(thread);
+  }
+  return tid;
+}
+
+// The first READY thread with the highest effective priority, or end() when they all have priority 0 and the
+// plain or group-aware order decides.
+std::deque<int>::iterator Scheduler::pickByPriority() {
+  auto best = readyQueue.end();
+  int bestPriority = 0;
+  for (auto it = readyQueue.begin(); it != readyQueue.end(); ++it) {
+    int priority = threads[*it]->getPriority();
+    if (priority > bestPriority) {
+      bestPriority = priority;
+      best = it;
     }
   }
-  readyQueue = tempQueue;
+  return best;
+}
+
+// Keeps prioritizedThreads in step, so picking stays a plain pop while nobody uses priorities.
+void Scheduler::setEffectivePriority(Thread* thread, int priority) {
+  prioritizedThreads += (priority != 0) - (thread->getPriority() != 0);
+  thread->setPriority(priority);
+}
+
+// Gang scheduling first: while a group's round is in progress, run its READY members that have not run in this
+// round back-to-back. Otherwise take the queue in order, skipping threads of groups that are ahead of their CPU
+// share (stride scheduling on the group pass). Ungrouped threads are always eligible.
+std::deque<int>::iterator Scheduler::pickGroupAware() {
+  if (gangGroup != -1) {
+    int round = groups[gangGroup].round;
+    for (auto it = readyQueue.begin(); it != readyQueue.end(); ++it) {
+      Thread* thread = threads[*it];
+      if (thread->getGroupId() == gangGroup && thread->getGangRound() != round) {
+        return it;
+      }
+    }
+    gangGroup = -1;
+  }
+
+  long minPass = 0;
+  bool anyGroup = false;
+  for (int tid : readyQueue) {
+    int gid = threads[tid]->getGroupId();
+    if (gid != -1 && (!anyGroup || groups[gid].pass < minPass)) {
+      minPass = groups[gid].pass;
+      anyGroup = true;
+    }
+  }
+  for (auto it = readyQueue.begin(); it != readyQueue.end(); ++it) {
+    int gid = threads[*it]->getGroupId();
+    if (gid == -1) {
+      return it;
+    }
+    if (groups[gid].pass <= minPass) {
+      groups[gid].round++;
+      gangGroup = gid;
+      groupVirtualTime = minPass;
+      return it;
+    }
+  }
+  return readyQueue.begin();
+}
+
+// Accounts the quantum a group member is about to run. A group that sat idle is lifted to the current virtual
+// time, the lowest pass among the groups with READY members when the last round started, so it cannot monopolize
+// the CPU with credit saved up while it had nothing to run.
+void Scheduler::chargeGroup(Thread* thread) {
+  ThreadGroup& group = groups[thread->getGroupId()];
+  if (group.pass < groupVirtualTime) {
+    group.pass = groupVirtualTime;
+  }
+  group.pass += GROUP_STRIDE / group.shares;
+  thread->setGangRound(group.round);
+}
+
+void Scheduler::leaveGroup(Thread* thread) {
+  int gid = thread->getGroupId();
+  if (gid == -1) {
+    return;
+  }
+  groups[gid].members--;
+  thread->setGroupId(-1);
+}
+
+// Releases a thread that is not running and no longer queued anywhere. Callers hold the timer signal blocked.
+void Scheduler::destroyThread(int tid) {
+  Thread* thread = threads[tid];
+  uthread_mutex_t* blockedOn = thread->getPiBlockedOn();
+  dropWaiters(thread);
+  if (blockedOn != nullptr) {
+    // The owner no longer inherits from this thread.
+    refreshPriority(getThreadById(MUTEX_OWNER(blockedOn->state) - 1));
+  }
+  setEffectivePriority(thread, 0);
+  leaveGroup(threads[tid]);
+  Arenas::release(thread->getArena());
+  Thread::destroy(thread);
+  threads[tid] = nullptr;
+}
+
+// Every spawned thread starts here, so returning from its entry point terminates it like uthread_exit.
+void Scheduler::threadMain() {
+  blockTimerSignal();
+  Thread* thread = threads[currentTid];
   unblockTimerSignal();
+  void* retval = nullptr;
+  if (thread->getRoutine() != nullptr) {
+    retval = thread->getRoutine()(thread->getArg());
+  } else {
+    thread->getEntryPoint()();
+  }
+  exitCurrent(retval);
+}
+
+// Hands the exit value of a dying thread to the threads parked joining it. A joinable thread nobody is joining yet
+// keeps its tid and value until a uthread_join collects them. Callers hold the timer signal blocked.
+void Scheduler::releaseJoiners(int tid) {
+  Thread* thread = threads[tid];
+  bool joined = false;
+  uthread_waiter* waiter;
+  while ((waiter = WaitQueue::pop(thread->getJoiners())) != nullptr) {
+    *static_cast<void**>(waiterData(waiter)) = thread->getRetval();
+    waiter->result = WAIT_HANDOFF;
+    unpark(waiter);
+    joined = true;
+  }
+  if (!joined && thread->getRoutine() != nullptr) {
+    exitValues[tid] = thread->getRetval();
+    exited[tid] = true;
+  }
+}
+
+// Whether something will eventually make a thread READY even though none is now: a sleeping thread's deadline or
+// a thread parked on I/O. Callers hold the timer signal blocked.
+bool Scheduler::canIdle() {
+  return !sleepingThreads.empty() || !Deadlines::empty() || Poller::hasWaiters();
+}
+
+// Nothing is READY: wait in the poller for one quantum's worth of time. The virtual timer stands still while the
+// process waits, so the idle quantum is counted here, and sleeping threads wake on the same schedule as when
+// others are running. Timer signal blocked.
+void Scheduler::idleWait() {
+  Poller::poll((quantumUsecs + 999) / 1000);
+  totalQuantums++;
+  wakeSleepingThreads();
+  wakeExpiredDeadlines();
 }
 
 int Scheduler::nextAvailableTid() {
   for (int tid = 0; tid < MAX_THREAD_NUM; ++tid) {
-    if (threads.count(tid) == 0) {
+    if (threads[tid] == nullptr && !exited[tid]) {
       return tid;
     }
   }
@@ -42,38 +252,110 @@ int Scheduler::nextAvailableTid() {
 }
 
 void Scheduler::wakeSleepingThreads() {
-    auto it = sleepingThreads.begin();
-    for ( ;it != sleepingThreads.end(); ) {
+  auto it = sleepingThreads.begin();
+  while (it != sleepingThreads.end()) {
     if (totalQuantums >= it->second) {
       int tid = it->first;
-      if (!threads[tid]->isUserBlocked()) {
-        threads[tid]->setState(READY);
-        readyQueue.push(tid);
-      }
       it = sleepingThreads.erase(it);
+      wakeSleeper(tid);
     } else {
       ++it;
     }
+  }
+}
+
+// Wakes the threads whose wall-clock deadline has passed and runs the timer callbacks that are due, in deadline
+// order, and re-arms the timer for the next.
+void Scheduler::wakeExpiredDeadlines() {
+  if (Deadlines::empty()) {
+    return;
+  }
+  long long now = Deadlines::now();
+  int slot;
+  while ((slot = Deadlines::popExpired(now)) != -1) {
+    if (slot >= MAX_THREAD_NUM) {
+      Timers::fire(slot - MAX_THREAD_NUM, now);
+    } else {
+      wakeSleeper(slot);
     }
+  }
+  Deadlines::arm();
+}
+
+// A sleep or a timed wait is over. Callers have removed the thread's deadline.
+void Scheduler::wakeSleeper(int tid) {
+  if (threads[tid]->isParked()) {
+    timeOutWaiters(threads[tid]);
+  }
+  if (!threads[tid]->isUserBlocked()) {
+    makeReady(tid);
+  }
 }
 
 
-void Scheduler::timerHandler(int sig) {
+// Runs on the carrier's signal stack.
+void Scheduler::timerHandler(int, siginfo_t*, void* context) {
     blockTimerSignal();
     wakeSleepingThreads();
+    // I/O completes and deadlines pass while threads compute too: pick them up once per quantum without blocking.
+    Poller::poll(0);
+    wakeExpiredDeadlines();
+    preempt(static_cast<ucontext_t*>(context));
+}
 
+// Switches out the thread the timer interrupted. Its context is copied out of the signal frame, so the signal stack
+// is free for the scheduler and the thread resumes later, on any carrier, through rt_sigreturn.
+void Scheduler::preempt(ucontext_t* context) {
+#ifdef __x86_64__
+    if (currentTid != pendingDeletionTid && current->getState() == RUNNING) {
+        current->setState(READY);
+        readyQueue.push_back(currentTid);
+    }
+    current->savePreempted(context);
+    runOnSchedulerStack();
+#else
+    // Elsewhere the handler runs on the interrupted thread's stack and switches from there, returning into the
+    // thread when it is resumed.
     unblockTimerSignal();
     doContextSwitch();
+    Signals::blockOnReturn(context);
+#endif
 }
 
+// Measures the XSAVE area of this process's signal frames, on a signal sent to itself before the timer starts, to
+// size the copies preempted threads keep.
+static size_t probedFpstateSize = 0;
+
+static void probeHandler(int, siginfo_t*, void* context) {
+  probedFpstateSize = Thread::fpstateSizeOf(static_cast<ucontext_t*>(context));
+}
+
+size_t Scheduler::probeFpstateSize() {
+  struct sigaction sa = {};
+  sa.sa_sigaction = probeHandler;
+  sigemptyset(&sa.sa_mask);
+  sa.sa_flags = SA_SIGINFO;
+  sigset_t set;
+  sigemptyset(&set);
+  sigaddset(&set, SIGVTALRM);
+  if (sigaction(SIGVTALRM, &sa, nullptr) < 0 || sigprocmask(SIG_UNBLOCK, &set, nullptr) < 0) {
+    std::cerr << "system error: failed to set signal handler" << std::endl;
+    exit(1);
+  }
+  raise(SIGVTALRM);
+  return probedFpstateSize;
+}
 
 void Scheduler::setupSignalHandler() {
   struct sigaction sa = {};\
 
 
-  sa.sa_handler = &Scheduler::timerHandler;
+  sa.sa_sigaction = &Scheduler::timerHandler;
   sigemptyset(&sa.sa_mask); // optional: don't block any signals during handler
-  sa.sa_flags = 0;
+  sa.sa_flags = SA_SIGINFO;
+#ifdef __x86_64__
+  sa.sa_flags |= SA_ONSTACK;
+#endif
 
   if (sigaction(SIGVTALRM, &sa, nullptr) < 0) {
     std::cerr << "system error: failed to set signal handler" << std::endl;
@@ -82,6 +364,9 @@ void Scheduler::setupSignalHandler() {
 }
 
 void Scheduler::setupTimer() {
+  if (embedded) {
+    return;
+  }
   struct itimerval timer{};
   timer.it_value.tv_sec = quantumUsecs / 1000000;
   timer.it_value.tv_usec = quantumUsecs % 1000000;
@@ -94,7 +379,11 @@ void Scheduler::setupTimer() {
   }
 }
 
+// Without the timer nothing preempts, so embedding mode skips the mask changes altogether.
 void Scheduler::blockTimerSignal() {
+  if (embedded) {
+    return;
+  }
   sigset_t set;
   if (sigemptyset(&set) == -1) {
     std::cerr << "system error: sigemptyset failed" << std::endl;
@@ -110,7 +399,11 @@ void Scheduler::blockTimerSignal() {
   }
 }
 
+// Timer callbacks run inside the scheduler, which must stay uninterrupted until they return.
 void Scheduler::unblockTimerSignal() {
+  if (embedded || Timers::inCallback()) {
+    return;
+  }
   sigset_t set;
   if (sigemptyset(&set) == -1) {
     std::cerr << "system error: sigemptyset failed" << std::endl;
@@ -126,25 +419,132 @@ void Scheduler::unblockTimerSignal() {
   }
 }
 
+// Gives the calling kernel thread the stack the scheduler switches threads on, and makes it the signal stack the
+// timer handler runs on.
+void Scheduler::setupCarrierStack() {
+  carrierStackSize = SCHEDULER_STACK_SIZE + sysconf(_SC_MINSIGSTKSZ);
+  carrierStack = new(std::nothrow) char[carrierStackSize];
+  if (carrierStack == nullptr) {
+    std::cerr << "system error: cannot allocate scheduler stack" << std::endl;
+    exit(1);
+  }
+  if (embedded) {
+    return;
+  }
+  carrierSignalStack.ss_sp = carrierStack;
+  carrierSignalStack.ss_size = carrierStackSize;
+  carrierSignalStack.ss_flags = 0;
+  if (sigaltstack(&carrierSignalStack, nullptr) == -1) {
+    std::cerr << "system error: sigaltstack failed" << std::endl;
+    exit(1);
+  }
+}
+
+// Only while the main thread is alone, so every thread runs on the kind of stack it started on.
+int Scheduler::setSharedStack(bool enabled) {
+#ifdef __x86_64__
+  blockTimerSignal();
+  for (int tid = 1; tid < MAX_THREAD_NUM; tid++) {
+    if (threads[tid] != nullptr) {
+      std::cerr << "thread library error: cannot switch stack modes while other threads exist" << std::endl;
+      unblockTimerSignal();
+      return -1;
+    }
+  }
+  if (enabled && SysMon::handoffEnabled()) {
+    std::cerr << "thread library error: shared stacks cannot be used with syscall handoff" << std::endl;
+    unblockTimerSignal();
+    return -1;
+  }
+  Thread::setSharedStack(enabled);
+  unblockTimerSignal();
+  return 0;
+#else
+  std::cerr << "thread library error: shared stacks are only supported on x86_64" << std::endl;
+  return -1;
+#endif
+}
+
 // **************************** Implementation of the Scheduler API ****************************************************
-int Scheduler::init(int quantum_usecs) {
+int Scheduler::init(int quantum_usecs, bool embeddedMode) {
   quantumUsecs = quantum_usecs;
+  embedded = embeddedMode;
 
   // Create main thread (tid 0)
-  auto* mainThread = new Thread(0, nullptr); // No entry point for main thread
+  Thread::initPool(threadMain, embedded ? 0 : probeFpstateSize());
+  setupCarrierStack();
+  auto* mainThread = Thread::create(0); // No entry point for main thread
   threads[0] = mainThread;
   mainThread->setState(RUNNING);
   currentTid = 0;
+  current = mainThread;
   mainThread->incrementQuantumCount();
   totalQuantums = 1; // Main thread gets the first quantum
+  mainThread->setLastRunQuantum(totalQuantums);
 
-  setupSignalHandler();
-  setupTimer();
+  // One bulk enqueue on the process stack, so that memmove is bound before unparkAll first needs it: resolving a
+  // lazily bound symbol saves the whole extended register state on the caller's stack, which a thread cannot spare.
+  int warmup[2] = {0, 0};
+  readyQueue.insert(readyQueue.end(), warmup, warmup + 2);
+  readyQueue.erase(readyQueue.end() - 2, readyQueue.end());
 
+  if (!embedded) {
+    setupSignalHandler();
+    setupTimer();
+  }
   return 0;
 }
 
-int Scheduler::spawn(void (*entryPoint)()) {
+// Embedding mode: lets the READY threads run on the host's thread until none is left or budgetUsecs have passed,
+// counting one quantum per call as the idle wait does. The budget is checked whenever a thread blocks, yields or
+// terminates, so at least one thread runs. Returns how many threads are READY afterwards.
+int Scheduler::runReady(long budgetUsecs) {
+  Poller::poll(0);
+  totalQuantums++;
+  wakeSleepingThreads();
+  wakeExpiredDeadlines();
+  if (!readyQueue.empty()) {
+    hostDeadline = Deadlines::after(budgetUsecs);
+    hostWaiting = true;
+    threads[0]->setState(BLOCKED);
+    doContextSwitch();
+    // Submits the I/O the threads queued and collects whatever completed while they ran.
+    Poller::poll(0);
+    wakeExpiredDeadlines();
+  }
+  return static_cast<int>(readyQueue.size());
+}
+
+// Microseconds until runReady has something to do: 0 while threads are READY, a quantum while threads sleep for
+// quanta, or until the earliest sleep, timeout or timer. -1 when only I/O, which the poller's descriptor reports,
+// or nothing at all can wake a thread.
+long Scheduler::nextDeadline() {
+  if (!readyQueue.empty()) {
+    return 0;
+  }
+  long next = sleepingThreads.empty() ? -1 : quantumUsecs;
+  long long earliest = Deadlines::earliest();
+  if (earliest != 0) {
+    long long left = (earliest - Deadlines::now() + 999) / 1000;
+    left = left < 0 ? 0 : left;
+    if (next == -1 || left < next) {
+      next = static_cast<long>(left);
+    }
+  }
+  return next;
+}
+
+bool Scheduler::isEmbedded() {
+  return embedded;
+}
+
+int Scheduler::yield() {
+  blockTimerSignal();
+  doContextSwitch();
+  return 0;
+}
+
+int Scheduler::spawn(void (*entryPoint)(), thread_routine routine, void* arg) {
   // Find the smallest available TID
   int tid = nextAvailableTid();
   if (tid == -1) {
@@ -154,9 +554,10 @@ int Scheduler::spawn(void (*entryPoint)()) {
 
   // Create the new thread and add it to the map and ready queue
   blockTimerSignal();
-  auto* newThread = new Thread(tid, entryPoint);
+  auto* newThread = Thread::create(tid);
+  newThread->setEntry(entryPoint, routine, arg);
   threads[tid] = newThread;
-  readyQueue.push(tid);
+  readyQueue.push_back(tid);
   unblockTimerSignal();
   return tid;
 }
@@ -170,10 +571,13 @@ int Scheduler::terminate(int tid) {
     {
         for (auto & thread : threads)
         {
-            delete thread.second;
+            if (thread != nullptr)
+            {
+                Thread::destroy(thread);
+                thread = nullptr;
+            }
         }
-        threads.clear();
-        unblockTimerSignal();
+        // Leave the timer signal blocked: a tick during exit() would find no threads to schedule.
         exit(0);
     }
 
@@ -181,22 +585,31 @@ int Scheduler::terminate(int tid) {
         removeFromReadyQueue(tid);
     }
 
+    if (tid != currentTid && threads[tid]->isHandedOff()) {
+        // Its stack is in use by the carrier blocked in the kernel; it exits itself once the call returns.
+        threads[tid]->setKillPending(true);
+        unblockTimerSignal();
+        return 0;
+    }
+
     if (tid != currentTid) {
         sleepingThreads.erase(tid);
-        delete threads[tid];
-        threads.erase(tid);
+        Deadlines::cancel(tid);
+        releaseJoiners(tid);
+        destroyThread(tid);
         unblockTimerSignal();
         return 0;
     }
 
 
-    if (readyQueue.empty()) {
+    if (readyQueue.empty() && WaitQueue::empty(threads[tid]->getJoiners()) && !hostWaiting && !canIdle()) {
         // Debug: No threads left to run
         std::cerr << "thread library error: no threads left to run after termination\n";
         unblockTimerSignal();
         return -1;
     }
 
+    releaseJoiners(tid);
     pendingDeletionTid = currentTid;
     threads[pendingDeletionTid]->setState(READY);
     doContextSwitch();
@@ -227,7 +640,7 @@ int Scheduler::block(int tid) {
     blockTimerSignal();
     thread->setState(BLOCKED);
 
-    if (readyQueue.empty()) { // No option to block without other ready thread
+    if (readyQueue.empty() && !hostWaiting && !canIdle()) { // No option to block without other ready thread
       std::cerr << "thread library error: no threads left to run after blocking\n";
       thread->setState(RUNNING);
       unblockTimerSignal();
@@ -242,7 +655,7 @@ int Scheduler::block(int tid) {
 }
 
 int Scheduler::resume(int tid) {
-  if (tid < 0 || threads.count(tid) == 0) {
+  if (tid < 0 || tid >= MAX_THREAD_NUM || threads[tid] == nullptr) {
     std::cerr << "thread library error: invalid tid" << std::endl;
     return -1;
   }
@@ -255,8 +668,8 @@ int Scheduler::resume(int tid) {
   }
 
   blockTimerSignal();
-  // If the thread is also sleeping, only change blocked flag
-  if (sleepingThreads.count(tid) > 0) {
+  // If the thread is also sleeping, parked or stuck in a handed-off syscall, only change blocked flag
+  if (sleepingThreads.count(tid) > 0 || Deadlines::contains(tid) || thread->isParked() || thread->isHandedOff()) {
       // Sleep time has not passed yet, keep it blocked but switch the flag
     thread->setBlockFlag(false);
     unblockTimerSignal();
@@ -264,8 +677,8 @@ int Scheduler::resume(int tid) {
   }
 
   // Move the thread to READY state and push it to the ready queue
-  thread->setState(READY);
-  readyQueue.push(tid);
+  thread->setBlockFlag(false);
+  makeReady(tid);
   unblockTimerSignal();
   return 0;
 }
@@ -276,14 +689,20 @@ int Scheduler::sleep(int numQuantums) {
   thread->setState(BLOCKED);
   sleepingThreads[currentTid] = totalQuantums + numQuantums;
 
-  if (readyQueue.empty()) { // No option to sleep without other thread ready
-    std::cerr << "thread library error: no threads left to run after sleep\n";
-    thread->setState(RUNNING);
-    sleepingThreads.erase(currentTid);
+  // Sleeping alone is fine: the scheduler idles until the deadline.
+  doContextSwitch();
+  return 0;
+}
+
+// Sleeps until a CLOCK_MONOTONIC deadline in nanoseconds. A deadline already passed returns at once.
+int Scheduler::sleepUntil(long long deadline) {
+  blockTimerSignal();
+  if (deadline <= Deadlines::now()) {
     unblockTimerSignal();
-    return -1;
+    return 0;
   }
-
+  threads[currentTid]->setState(BLOCKED);
+  Deadlines::set(currentTid, deadline);
   doContextSwitch();
   return 0;
 }
@@ -292,9 +711,11 @@ int Scheduler::sleep(int numQuantums) {
 void Scheduler::doContextSwitch() {
     blockTimerSignal();
 
-    if (currentTid != pendingDeletionTid && threads.size() > 1) {
+    // Only a preempted or yielding thread goes back to READY; a thread that blocked or went to sleep stays off
+    // the queue until it is woken.
+    if (currentTid != pendingDeletionTid && threads[currentTid]->getState() == RUNNING) {
         threads[currentTid]->setState(READY);
-        readyQueue.push(currentTid);
+        readyQueue.push_back(currentTid);
     }
 
     // Save the current thread's environment
@@ -302,34 +723,342 @@ void Scheduler::doContextSwitch() {
     if (ret_val != 0) {
         // Returning to this thread
         if (pendingDeletionTid != -1) {
-            delete threads[pendingDeletionTid];
-            threads.erase(pendingDeletionTid);
+            destroyThread(pendingDeletionTid);
             pendingDeletionTid = -1;
         }
         unblockTimerSignal();
         return;
     }
+#ifdef __x86_64__
+    // Nothing below this point is live once the thread is switched out.
+    char* sp;
+    asm volatile("mov %%rsp, %0" : "=r"(sp));
+    current->setStackLow(sp);
+#endif
+    runOnSchedulerStack();
+}
+
+// Leaves the stack of the thread just switched out for the carrier's own and picks the next thread there.
+void Scheduler::runOnSchedulerStack() {
+#ifdef __x86_64__
+    asm volatile("mov %0, %%rsp\n\t"
+                 "call *%1"
+                 : : "r"(carrierStack + carrierStackSize), "r"(&Scheduler::switchToNext) : "memory");
+    __builtin_unreachable();
+#else
+    switchToNext();
+#endif
+}
+
+// Runs on the scheduler stack once the outgoing thread is saved, and resumes the next one. Does not return.
+void Scheduler::switchToNext() {
+    // A carrier coming back from a handed-off syscall is waiting for the token; the current thread is saved, so
+    // give the token back and park this carrier.
+    if (SysMon::returnerWaiting()) {
+        SysMon::handBack();
+    }
+
+    if (hostWaiting && currentTid != 0 && (readyQueue.empty() || Deadlines::now() >= hostDeadline)) {
+        // Embedding mode: nothing left to run or the budget is spent, so the host gets its thread back.
+        hostWaiting = false;
+        currentTid = 0;
+        threads[0]->setState(RUNNING);
+    } else {
+        // The outgoing thread blocked and nobody else is READY: idle in the poller until a sleeper's deadline or
+        // I/O readiness wakes someone.
+        while (readyQueue.empty() && threads[currentTid]->getState() != RUNNING) {
+            idleWait();
+            if (SysMon::returnerWaiting()) {
+                SysMon::handBack();
+            }
+        }
+
+        if (!readyQueue.empty()){
+            currentTid = pickNextTid();
+            threads[currentTid]->setState(RUNNING);
+        }
+    }
+    current = threads[currentTid];
+    current->incrementQuantumCount();
+    totalQuantums++;
+    current->setLastRunQuantum(totalQuantums);
+
+    setupTimer();
+    resumeThread(current);
+}
 
-    if (!readyQueue.empty()){
-        int nextTid = readyQueue.front();
-        readyQueue.pop();
-        currentTid = nextTid;
-        threads[currentTid]->setState(RUNNING);
+// Starts a thread that never ran, or continues it from where it was switched out: at the sigsetjmp of a switch it
+// made itself, or at the instruction the timer preempted. Does not return.
+void Scheduler::resumeThread(Thread* thread) {
+#ifdef __x86_64__
+    // Off its stack, a thread that terminated itself can go now: a preempted thread does not return through
+    // doContextSwitch to destroy it, and its frames need not be copied off the shared stack.
+    if (pendingDeletionTid != -1) {
+        destroyThread(pendingDeletionTid);
+        pendingDeletionTid = -1;
     }
-    threads[currentTid]->incrementQuantumCount();
+#endif
+    if (!thread->isStarted()) {
+        thread->start();
+    }
+#ifdef __x86_64__
+    thread->claimStack();
+    if (thread->isPreempted()) {
+        ucontext_t* context = thread->takePreempted();
+        // rt_sigreturn installs the signal stack recorded in the frame, which must be this carrier's, and restores
+        // the mask the thread was interrupted with, which predates any signal routed to uthread_signal_wait since.
+        context->uc_stack = carrierSignalStack;
+        Signals::blockOnReturn(context);
+        asm volatile("mov %0, %%rsp\n\t"
+                     "mov %1, %%eax\n\t"
+                     "syscall"
+                     : : "r"(context), "i"(__NR_rt_sigreturn) : "memory");
+        __builtin_unreachable();
+    }
+#endif
+    siglongjmp(thread->getEnv(), 1);
+}
+
+
+bool Scheduler::hasReadyThreads() {
+    return !readyQueue.empty();
+}
+
+// Called by the monitor while the owning carrier is inside a blocking region, so nothing else touches the
+// scheduler. The thread keeps its stack and registers on that carrier and is not runnable until it returns.
+void Scheduler::markHandedOff(int tid) {
+    threads[tid]->setState(BLOCKED);
+    threads[tid]->setHandedOff(true);
+}
+
+// Runs on a carrier that has just taken the token over from one stuck in the kernel. Does not return.
+void Scheduler::dispatchFromCarrier() {
+    currentTid = pickNextTid();
+    current = threads[currentTid];
+    current->setState(RUNNING);
+    current->incrementQuantumCount();
     totalQuantums++;
+    current->setLastRunQuantum(totalQuantums);
 
     setupTimer();
-    siglongjmp(threads[currentTid]->getEnv(), 1);
+    resumeThread(current);
 }
 
+// Runs on a carrier whose blocking region ended after its token was taken over. The thread it was running picks
+// up where it left off as the RUNNING thread of a new quantum.
+void Scheduler::resumeFromSyscall(int tid) {
+    if (pendingDeletionTid != -1) {
+        destroyThread(pendingDeletionTid);
+        pendingDeletionTid = -1;
+    }
+
+    Thread* thread = threads[tid];
+    thread->setHandedOff(false);
+    currentTid = tid;
+    current = thread;
+    thread->setState(RUNNING);
+    thread->incrementQuantumCount();
+    totalQuantums++;
+    thread->setLastRunQuantum(totalQuantums);
+    setupTimer();
+
+    if (thread->isKillPending()) {
+        terminate(tid);
+    } else if (thread->isUserBlocked() && !readyQueue.empty()) {
+        thread->setState(BLOCKED);
+        doContextSwitch();
+    }
+}
+
+// Waiters for the RUNNING thread to queue with addWaiter, cleared, count at most UTHREAD_SELECT_MAX_CASES.
+uthread_waiter* Scheduler::takeWaiters(int count) {
+    return current->takeWaiters(count);
+}
+
+// The payload a waiter points to, such as the element buffer of a channel operation, which may be on the parked
+// thread's stack and copied out with it in shared-stack mode.
+void* Scheduler::waiterData(uthread_waiter* waiter) {
+    return threads[waiter->tid]->locate(waiter->data);
+}
+
+// Queues a waiter of the running thread. Once parked, the thread stays BLOCKED until a waker dequeues one of its
+// waiters and unparks it.
+void Scheduler::addWaiter(uthread_waitq_t* queue, uthread_waiter* waiter) {
+    Thread* thread = threads[currentTid];
+    waiter->tid = currentTid;
+    waiter->result = 0;
+    waiter->sibling = thread->getWaiters();
+    thread->setWaiters(waiter);
+    WaitQueue::push(queue, waiter);
+}
+
+// Blocks the running thread until one of its queued waiters is unparked, or for at most timeoutQuantums quantums
+// (0 for no timeout), counted like uthread_sleep and woken by the same sleeper check, or until a CLOCK_MONOTONIC
+// deadline in nanoseconds (0 for none). A deadline that already passed times the waiters out without switching.
+// Returns with the timer signal unblocked. Fails without parking, and with its waiters dropped, when nothing could
+// ever wake it: no other thread is READY, sleeping or waiting for I/O.
+int Scheduler::parkCurrent(int timeoutQuantums, long long deadline) {
+    Thread* thread = threads[currentTid];
+    if (Timers::inCallback()) {
+        dropWaiters(thread);
+        std::cerr << "thread library error: a timer callback cannot block\n";
+        return -1;
+    }
+    if (deadline != 0 && deadline <= Deadlines::now()) {
+        timeOutWaiters(thread);
+        unblockTimerSignal();
+        return 0;
+    }
+    if (readyQueue.empty() && timeoutQuantums == 0 && deadline == 0 && !hostWaiting && !canIdle()) {
+        dropWaiters(thread);
+        std::cerr << "thread library error: no threads left to run, waiting would deadlock\n";
+        unblockTimerSignal();
+        return -1;
+    }
+    thread->setState(BLOCKED);
+    thread->setParked(true);
+    if (timeoutQuantums > 0) {
+        sleepingThreads[currentTid] = totalQuantums + timeoutQuantums;
+    }
+    if (deadline != 0) {
+        Deadlines::set(currentTid, deadline);
+    }
+    doContextSwitch();
+    return 0;
+}
+
+// Wakes the owner of a waiter the caller has just dequeued. Its other waiters are unlinked here, in the same
+// critical section, so a thread waiting on several queues is woken exactly once.
+void Scheduler::unpark(uthread_waiter* waiter, bool runNext) {
+    Thread* thread = threads[waiter->tid];
+    dropWaiters(thread);
+    thread->setParked(false);
+    sleepingThreads.erase(waiter->tid);
+    Deadlines::cancel(waiter->tid);
+    if (!thread->isUserBlocked()) {
+        makeReady(waiter->tid, runNext);
+    }
+}
+
+// Wakes every waiter on the queue with the given result. The runnable ones are appended to READY in queue order
+// with a single insert, so releasing a crowd costs one queue operation instead of one per thread. Returns the
+// number of waiters dequeued.
+int Scheduler::unparkAll(uthread_waitq_t* queue, int result) {
+    // Static rather than on the waker's small stack; the timer signal is blocked, so no other call can be using it.
+    static int batch[MAX_THREAD_NUM];
+    int runnable = 0;
+    int woken = 0;
+    uthread_waiter* waiter;
+    while ((waiter = WaitQueue::pop(queue)) != nullptr) {
+        woken++;
+        waiter->result = result;
+        Thread* thread = threads[waiter->tid];
+        dropWaiters(thread);
+        thread->setParked(false);
+        sleepingThreads.erase(waiter->tid);
+        Deadlines::cancel(waiter->tid);
+        if (!thread->isUserBlocked()) {
+            thread->setState(READY);
+            thread->setWokenAffine(false);
+            batch[runnable++] = waiter->tid;
+        }
+    }
+    readyQueue.insert(readyQueue.end(), batch, batch + runnable);
+    tailWakeups += runnable;
+    return woken;
+}
+
+void Scheduler::dropWaiters(Thread* thread) {
+    for (uthread_waiter* waiter = thread->getWaiters(); waiter != nullptr; waiter = waiter->sibling) {
+        WaitQueue::remove(waiter);
+    }
+    thread->setWaiters(nullptr);
+}
+
+// The sleeper check found a parked thread past its timeout: tell each of its waiters and unlink them.
+void Scheduler::timeOutWaiters(Thread* thread) {
+    for (uthread_waiter* waiter = thread->getWaiters(); waiter != nullptr; waiter = waiter->sibling) {
+        waiter->result = WAIT_TIMEDOUT;
+    }
+    dropWaiters(thread);
+    thread->setParked(false);
+}
+
+// Terminates the running thread with an exit value for its joiners, once the destructors of its thread-local values
+// have run on its own stack.
+int Scheduler::exitCurrent(void* retval) {
+    Keys::runDestructors(current);
+    current->setRetval(retval);
+    return terminate(currentTid);
+}
+
+// Collects a joinable thread that already exited, or parks until the thread terminates or the deadline passes, in
+// which case it returns 1.
+int Scheduler::join(int tid, void** retval, long long deadline) {
+    blockTimerSignal();
+    if (exited[tid]) {
+        if (retval != nullptr) {
+            *retval = exitValues[tid];
+        }
+        exited[tid] = false;
+        unblockTimerSignal();
+        return 0;
+    }
+    if (threads[tid] == nullptr) {
+        std::cerr << "thread library error: there is no thread with id: " << tid << std::endl;
+        unblockTimerSignal();
+        return -1;
+    }
+    if (tid == currentTid) {
+        std::cerr << "thread library error: a thread cannot join itself" << std::endl;
+        unblockTimerSignal();
+        return -1;
+    }
+
+    void* value = nullptr;
+    uthread_waiter& waiter = *takeWaiters(1);
+    waiter.data = &value;
+    addWaiter(threads[tid]->getJoiners(), &waiter);
+    if (parkCurrent(0, deadline) < 0) {
+        return -1;
+    }
+    if (waiter.result == WAIT_TIMEDOUT) {
+        return 1;
+    }
+    if (retval != nullptr) {
+        *retval = value;
+    }
+    return 0;
+}
 
 int Scheduler::getTid() {
   return currentTid;
 }
 
+Thread* Scheduler::currentThread() {
+  return current;
+}
+
+// Timer signal blocked.
+void Scheduler::clearKey(int key) {
+  for (Thread* thread : threads) {
+    if (thread != nullptr) {
+      thread->getSpecific()[key] = nullptr;
+    }
+  }
+}
+
+void Scheduler::blockInSavedMasks(const sigset_t* set) {
+  for (Thread* thread : threads) {
+    if (thread != nullptr) {
+      sigset_t* saved = &thread->getEnv()->__saved_mask;
+      sigorset(saved, saved, set);
+    }
+  }
+}
+
 Thread* Scheduler::getThreadById(int tid) {
-  if (threads.count(tid) == 0) return nullptr;
+  if (tid < 0 || tid >= MAX_THREAD_NUM) return nullptr;
   return threads[tid];
 }
 
@@ -339,12 +1068,135 @@ int Scheduler::getTotalQuantums() {
 
 int Scheduler::getQuantums(int tid) {
     blockTimerSignal();
-    if (threads.count(tid) == 0) {
+    if (tid < 0 || tid >= MAX_THREAD_NUM || threads[tid] == nullptr) {
         std::cerr << "thread library error: invalid tid" << std::endl;
+        unblockTimerSignal();
         return -1;
       }
+    int quantums = threads[tid]->getQuantumCount();
     unblockTimerSignal();
-    return threads[tid]->getQuantumCount();
+    return quantums;
+}
+
+int Scheduler::setPriority(int tid, int priority) {
+    blockTimerSignal();
+    if (threads[tid] == nullptr) {
+        std::cerr << "thread library error: there is no thread with id: " << tid << std::endl;
+        unblockTimerSignal();
+        return -1;
+    }
+    threads[tid]->setBasePriority(priority);
+    refreshPriority(threads[tid]);
+    unblockTimerSignal();
+    return 0;
+}
+
+int Scheduler::getPriority(int tid) {
+    blockTimerSignal();
+    if (threads[tid] == nullptr) {
+        std::cerr << "thread library error: there is no thread with id: " << tid << std::endl;
+        unblockTimerSignal();
+        return -1;
+    }
+    int priority = threads[tid]->getPriority();
+    unblockTimerSignal();
+    return priority;
+}
+
+// Recomputes a thread's effective priority from its base and the waiters of the contended PI mutexes it owns. A
+// change is carried on to the owner of the PI mutex the thread itself waits for, and so on along the chain; the
+// hop limit only matters for a deadlocked cycle. READY threads need no repositioning, since picking scans by
+// priority. Timer signal blocked.
+void Scheduler::refreshPriority(Thread* thread) {
+    for (int hops = 0; thread != nullptr && hops < MAX_THREAD_NUM; hops++) {
+        int priority = thread->getBasePriority();
+        for (uthread_mutex_t* mutex = thread->getPiHeld(); mutex != nullptr; mutex = mutex->pi_next) {
+            for (uthread_waiter* waiter = mutex->waiters.head; waiter != nullptr; waiter = waiter->next) {
+                priority = std::max(priority, threads[waiter->tid]->getPriority());
+            }
+        }
+        if (priority == thread->getPriority()) {
+            return;
+        }
+        setEffectivePriority(thread, priority);
+        uthread_mutex_t* blockedOn = thread->getPiBlockedOn();
+        thread = blockedOn == nullptr ? nullptr : getThreadById(MUTEX_OWNER(blockedOn->state) - 1);
+    }
+}
+
+int Scheduler::setWakeAffine(int windowQuantums) {
+    blockTimerSignal();
+    wakeAffineWindow = windowQuantums;
+    affineStreak = 0;
+    unblockTimerSignal();
+    return 0;
+}
+
+void Scheduler::getWakeStats(int *affine, int *tail) {
+    blockTimerSignal();
+    *affine = affineWakeups;
+    *tail = tailWakeups;
+    unblockTimerSignal();
+}
+
+int Scheduler::groupCreate(int shares) {
+    blockTimerSignal();
+    int gid = 0;
+    while (gid < MAX_THREAD_NUM && groups.count(gid) != 0) {
+        gid++;
+    }
+    if (gid == MAX_THREAD_NUM) {
+        std::cerr << "thread library error: reached maximum group limit" << std::endl;
+        unblockTimerSignal();
+        return -1;
+    }
+    // Start at the current virtual time, not 0, so a new group does not get a burst of catch-up quanta.
+    groups[gid] = ThreadGroup{shares, groupVirtualTime, 0, 0};
+    unblockTimerSignal();
+    return gid;
+}
+
+int Scheduler::groupJoin(int gid, int tid) {
+    blockTimerSignal();
+    if (groups.count(gid) == 0) {
+        std::cerr << "thread library error: there is no group with id: " << gid << std::endl;
+        unblockTimerSignal();
+        return -1;
+    }
+    Thread* thread = threads[tid];
+    leaveGroup(thread);
+    thread->setGroupId(gid);
+    thread->setGangRound(groups[gid].round);
+    groups[gid].members++;
+    unblockTimerSignal();
+    return 0;
+}
+
+int Scheduler::groupLeave(int tid) {
+    blockTimerSignal();
+    leaveGroup(threads[tid]);
+    unblockTimerSignal();
+    return 0;
+}
+
+int Scheduler::groupDestroy(int gid) {
+    blockTimerSignal();
+    if (groups.count(gid) == 0) {
+        std::cerr << "thread library error: there is no group with id: " << gid << std::endl;
+        unblockTimerSignal();
+        return -1;
+    }
+    for (Thread* thread : threads) {
+        if (thread != nullptr && thread->getGroupId() == gid) {
+            leaveGroup(thread);
+        }
+    }
+    groups.erase(gid);
+    if (gangGroup == gid) {
+        gangGroup = -1;
+    }
+    unblockTimerSignal();
+    return 0;
 }
 
 
@@ -352,8 +1204,13 @@ int Scheduler::getQuantums(int tid) {
 void Scheduler::debugPrintThreads()
 {
     std::cout << "=== THREADS REGISTERS DEBUG INFO ===" << std::endl;
-    for (const auto& [tid, thread] : threads)
+    for (int tid = 0; tid < MAX_THREAD_NUM; tid++)
     {
+        Thread* thread = threads[tid];
+        if (thread == nullptr)
+        {
+            continue;
+        }
         std::cout << "Thread ID: " << tid << ", ";
 
         address_t sp = thread->getEnv()->__jmpbuf[JB_SP];
@@ -384,11 +1241,9 @@ void Scheduler::debugPrintThreads()
     }
     // Now print the readyQueue contents
     std::cout << "--- Ready Queue ---" << std::endl;
-    std::queue<int> tempQueue = readyQueue; // copy it so we don't destroy the original
-    while (!tempQueue.empty())
+    for (int tid : readyQueue)
     {
-        std::cout << tempQueue.front() << " ";
-        tempQueue.pop();
+        std::cout << tid << " ";
     }
     std::cout << std::endl;
     std::cout << "====================================" << std::endl;
@@ -6,8 +6,20 @@
 #define _SCHEDULER_H_
 
 #include "thread.h"
+#include "waitqueue.h"
 #include <unordered_map>
 #include <queue>
+#include <deque>
+
+// A gang of threads that run back-to-back, and share the CPU with other groups in proportion to their shares.
+struct ThreadGroup {
+    int shares;
+    long pass;      // stride-scheduling virtual time, advanced by GROUP_STRIDE / shares per quantum run
+    int members;
+    int round;      // current gang round; members that already ran in it carry the same number
+};
+
+#define SCHEDULER_STACK_SIZE 65536  /* per carrier, on top of the kernel's minimum for a signal frame */
 
 class Scheduler {
 private:
@@ -16,31 +28,116 @@ private:
     static int nextAvailableTid();
     static void removeFromReadyQueue(int tid);
     static void wakeSleepingThreads();
-    static void blockTimerSignal();
-    static void unblockTimerSignal();
+    static void wakeExpiredDeadlines();
+    static void wakeSleeper(int tid);
+    static bool canIdle();
+    static void idleWait();
+    static void makeReady(int tid, bool runNext = false);
+    static int pickNextTid();
+    static std::deque<int>::iterator pickGroupAware();
+    static std::deque<int>::iterator pickByPriority();
+    static void setEffectivePriority(Thread* thread, int priority);
+    static void chargeGroup(Thread* thread);
+    static void leaveGroup(Thread* thread);
+    static void destroyThread(int tid);
+    static void threadMain();
+    static size_t probeFpstateSize();
+    static void preempt(ucontext_t* context);
+    static void runOnSchedulerStack();
+    static void switchToNext();
+    static void resumeThread(Thread* thread);
+    static void releaseJoiners(int tid);
 
     static int quantumUsecs;
     static int totalQuantums;
-    static std::unordered_map<int, Thread*> threads;
-    static std::queue<int> readyQueue;
+    static Thread* threads[MAX_THREAD_NUM];        // by tid, null where no thread lives
+    static std::deque<int> readyQueue;
     static std::unordered_map<int, int> sleepingThreads;
+    static void* exitValues[MAX_THREAD_NUM];       // exited joinable threads nobody has joined yet
+    static bool exited[MAX_THREAD_NUM];             // whether exitValues holds a value for the tid
     static int currentTid;
+    static Thread* current;     // threads[currentTid], kept up to date at every switch for the hot paths
+
+    // Each carrier switches threads on a stack of its own, which is also its signal stack, so no thread's stack
+    // holds scheduler frames or the timer's signal frame.
+    static thread_local char* carrierStack;
+    static thread_local size_t carrierStackSize;
+    static thread_local stack_t carrierSignalStack;
+
+    // Cache-affine wakeups: a thread woken within wakeAffineWindow quanta of its last run is queued at the head
+    // of READY so it runs while its stack and working set are still warm. 0 disables (plain FIFO).
+    static int wakeAffineWindow;
+    static int affineStreak;
+    static int affineWakeups;
+    static int tailWakeups;
+
+    static int prioritizedThreads;  // threads whose effective priority is not 0
+
+    static std::unordered_map<int, ThreadGroup> groups;
+    static int gangGroup;       // group whose gang round is in progress, -1 if none
+    static long groupVirtualTime;
+
+    // Embedding mode: no virtual timer, the host drives the scheduler from its own loop through runReady.
+    static bool embedded;
+    static bool hostWaiting;    // the main thread is inside runReady, waiting for the threads it let run
+    static long long hostDeadline;
 
 public:
-    static int init(int quantumUsecs);
-    static int spawn(void (*entryPoint)(void));
+    static int init(int quantumUsecs, bool embedded = false);
+    static int runReady(long budgetUsecs);
+    static long nextDeadline();
+    static bool isEmbedded();
+    static int yield();
+    static int spawn(void (*entryPoint)(void), thread_routine routine = nullptr, void* arg = nullptr);
     static int terminate(int tid);
+    static int exitCurrent(void* retval);
+    static int join(int tid, void** retval, long long deadline = 0);
     static int block(int tid);
     static int resume(int tid);
     static int sleep(int numQuantums);
-    static void timerHandler(int sig);
+    static int sleepUntil(long long deadline);
+    static void timerHandler(int sig, siginfo_t* info, void* context);
     static void doContextSwitch();
+    static void blockTimerSignal();
+    static void unblockTimerSignal();
+    static void setupCarrierStack();
+    static int setSharedStack(bool enabled);
+
+    // Syscall handoff, see sysmon.h. All of these run on the carrier holding the scheduler token.
+    static bool hasReadyThreads();
+    static void markHandedOff(int tid);
+    static void dispatchFromCarrier();
+    static void resumeFromSyscall(int tid);
+
+    // Adds set to the signal mask every thread resumes with. Timer signal blocked.
+    static void blockInSavedMasks(const sigset_t* set);
+
+    // Parking, the core of every blocking primitive. All of these run with the timer signal blocked.
+    static uthread_waiter* takeWaiters(int count);
+    static void* waiterData(uthread_waiter* waiter);
+    static void addWaiter(uthread_waitq_t* queue, uthread_waiter* waiter);
+    static int parkCurrent(int timeoutQuantums, long long deadline = 0);
+    static void unpark(uthread_waiter* waiter, bool runNext = false);
+    static int unparkAll(uthread_waitq_t* queue, int result);
+    static void dropWaiters(Thread* thread);
+    static void timeOutWaiters(Thread* thread);
 
     static int getTid();
     static int getTotalQuantums();
     static int getQuantums(int tid);
+    static int setPriority(int tid, int priority);
+    static int getPriority(int tid);
+    static void refreshPriority(Thread* thread);
+    static int setWakeAffine(int windowQuantums);
+    static void getWakeStats(int *affine, int *tail);
+    static int groupCreate(int shares);
+    static int groupJoin(int gid, int tid);
+    static int groupLeave(int tid);
+    static int groupDestroy(int gid);
     static int pendingDeletionTid;
     static Thread *getThreadById (int tid);
+    static Thread* currentThread();
+    static void clearKey(int key);
 
     static void debugPrintThreads();
 };
@@ -0,0 +1,137 @@
+#include "signals.h"
+#include "scheduler.h"
+#include "sysmon.h"
+#include "poller.h"
+#include "waitqueue.h"
+#include <cerrno>
+#include <iostream>
+#include <sys/signalfd.h>
+#include <unistd.h>
+
+// All of these run with the timer signal blocked.
+
+// Static variables initialization
+sigset_t Signals::routed;
+sigset_t Signals::pending;
+int Signals::signalFd = -1;
+uthread_waitq_t Signals::waiters;
+
+//************************* Implementation of the private functions ****************************************************
+// Blocks the signals in mask wherever uthreads run: on this carrier, in the context every thread resumes with, and
+// in the carriers' homes. Then points the signalfd at them.
+void Signals::route(const sigset_t* mask) {
+  sigset_t added;
+  sigemptyset(&added);
+  for (int signo = 1; signo < NSIG; signo++) {
+    if (sigismember(mask, signo) == 1 && sigismember(&routed, signo) != 1) {
+      sigaddset(&added, signo);
+      sigaddset(&routed, signo);
+    }
+  }
+  if (sigisemptyset(&added)) {
+    return;
+  }
+  if (pthread_sigmask(SIG_BLOCK, &added, nullptr) != 0) {
+    std::cerr << "system error: cannot block signals" << std::endl;
+    exit(1);
+  }
+  Scheduler::blockInSavedMasks(&added);
+  SysMon::blockInHomes(&added);
+
+  int fd = signalfd(signalFd, &routed, SFD_NONBLOCK | SFD_CLOEXEC);
+  if (fd == -1) {
+    std::cerr << "system error: cannot create signalfd" << std::endl;
+    exit(1);
+  }
+  if (signalFd == -1) {
+    signalFd = fd;
+    WaitQueue::init(&waiters);
+    Poller::watch(signalFd);
+  }
+}
+
+// Removes and returns the lowest pending signal in mask, or 0 if there is none.
+int Signals::takePending(const sigset_t* mask) {
+  for (int signo = 1; signo < NSIG; signo++) {
+    if (sigismember(&pending, signo) == 1 && sigismember(mask, signo) == 1) {
+      sigdelset(&pending, signo);
+      return signo;
+    }
+  }
+  return 0;
+}
+
+// **************************** Implementation of the Signals API *****************************************************
+// The mask a new context starts with: the routed signals must stay blocked in every thread.
+void Signals::initMask(sigset_t* mask) {
+  if (signalFd == -1) {
+    sigemptyset(mask);
+  } else {
+    *mask = routed;
+  }
+}
+
+// Called by the timer handler before it returns to the thread it interrupted.
+void Signals::blockOnReturn(ucontext_t* context) {
+  if (signalFd != -1) {
+    sigorset(&context->uc_sigmask, &context->uc_sigmask, &routed);
+  }
+}
+
+int Signals::fd() {
+  return signalFd;
+}
+
+bool Signals::hasWaiters() {
+  return signalFd != -1 && !WaitQueue::empty(&waiters);
+}
+
+// Hands each signal read to the longest waiting thread that waits for it. A signal nobody waits for stays pending,
+// and like a blocked signal it is only kept once however often it arrives. Called by the poller.
+void Signals::drain() {
+  signalfd_siginfo info;
+  while (true) {
+    ssize_t bytes = read(signalFd, &info, sizeof(info));
+    if (bytes == -1 && errno == EINTR) {
+      continue;
+    }
+    if (bytes != static_cast<ssize_t>(sizeof(info))) {
+      return;
+    }
+    int signo = static_cast<int>(info.ssi_signo);
+    uthread_waiter* prev = nullptr;
+    uthread_waiter* waiter = waiters.head;
+    while (waiter != nullptr
+           && sigismember(&static_cast<SignalWait*>(Scheduler::waiterData(waiter))->mask, signo) != 1) {
+      prev = waiter;
+      waiter = waiter->next;
+    }
+    if (waiter == nullptr) {
+      sigaddset(&pending, signo);
+      continue;
+    }
+    WaitQueue::unlink(&waiters, prev, waiter);
+    static_cast<SignalWait*>(Scheduler::waiterData(waiter))->signo = signo;
+    Scheduler::unpark(waiter);
+  }
+}
+
+// Returns the signal that arrived.
+int Signals::wait(const sigset_t* mask) {
+  Scheduler::blockTimerSignal();
+  route(mask);
+  int signo = takePending(mask);
+  if (signo != 0) {
+    Scheduler::unblockTimerSignal();
+    return signo;
+  }
+
+  SignalWait wait{*mask, 0};
+  uthread_waiter& waiter = *Scheduler::takeWaiters(1);
+  waiter.data = &wait;
+  Scheduler::addWaiter(&waiters, &waiter);
+  if (Scheduler::parkCurrent(0) < 0) {
+    return -1;
+  }
+  return wait.signo;
+}
@@ -0,0 +1,40 @@
+//
+// Process signals turned into ordinary wakeups. Signals a thread waits for are blocked in every context the library
+// runs and read from a signalfd the poller watches, so they never interrupt a uthread and no handler ever runs
+// inside the scheduler.
+//
+
+#ifndef _SIGNALS_H_
+#define _SIGNALS_H_
+
+#include "uthreads.h"
+#include <signal.h>
+#include <ucontext.h>
+
+// What a thread in uthread_signal_wait waits for, on its stack. The mask is copied in, for the waker to find it
+// through Scheduler::waiterData along with the rest.
+struct SignalWait {
+    sigset_t mask;
+    int signo;              // set by the waker
+};
+
+class Signals {
+private:
+    static void route(const sigset_t* mask);
+    static int takePending(const sigset_t* mask);
+
+    static sigset_t routed;     // signals delivered through the signalfd, once waited for they stay so
+    static sigset_t pending;    // arrived while no thread waited for them
+    static int signalFd;
+    static uthread_waitq_t waiters;
+
+public:
+    static void initMask(sigset_t* mask);
+    static void blockOnReturn(ucontext_t* context);
+    static int fd();
+    static bool hasWaiters();
+    static void drain();
+    static int wait(const sigset_t* mask);
+};
+
+#endif //_SIGNALS_H_
@@ -0,0 +1,622 @@
+#include "sync.h"
+#include "scheduler.h"
+#include "waitqueue.h"
+#include "futex.h"
+#include <climits>
+#include <iostream>
+
+// The fast paths are single atomic operations that run with the timer signal unblocked. Slow paths block it, and
+// since only the carrier holding the scheduler token runs uthreads, nothing else can touch the mutex meanwhile.
+
+//************************* Implementation of the private functions ****************************************************
+// Returns 1 if the deadline passed before the mutex could be taken.
+int Sync::mutexLockSlow(uthread_mutex_t* mutex, int self, long long deadline) {
+  Scheduler::blockTimerSignal();
+  while (true) {
+    int state = __atomic_load_n(&mutex->state, __ATOMIC_RELAXED);
+    if (MUTEX_OWNER(state) == 0) {
+      // Free, either after a barging wakeup or because the last holder left no one to hand it to.
+      // A plain store is enough: with the timer signal blocked no other thread runs until this one unblocks it.
+      int contended = WaitQueue::empty(&mutex->waiters) ? 0 : MUTEX_CONTENDED;
+      __atomic_store_n(&mutex->state, self | contended, __ATOMIC_RELAXED);
+      Scheduler::unblockTimerSignal();
+      return 0;
+    }
+    __atomic_store_n(&mutex->state, state | MUTEX_CONTENDED, __ATOMIC_RELAXED);
+
+    uthread_waiter& waiter = *Scheduler::takeWaiters(1);
+    Scheduler::addWaiter(&mutex->waiters, &waiter);
+    if (mutex->kind == UTHREAD_MUTEX_PI) {
+      piQueued(mutex, self - 1);
+    }
+    if (Scheduler::parkCurrent(0, deadline) < 0) {
+      Scheduler::blockTimerSignal();
+      mutexAbandon(mutex, self);
+      Scheduler::unblockTimerSignal();
+      return -1;
+    }
+    if (waiter.result == WAIT_HANDOFF) {
+      return 0; // the unlocking thread handed ownership over directly
+    }
+    Scheduler::blockTimerSignal();
+    if (waiter.result == WAIT_TIMEDOUT) {
+      mutexAbandon(mutex, self);
+      Scheduler::unblockTimerSignal();
+      return 1;
+    }
+  }
+}
+
+// A waiter left the queue without the mutex: it stops looking contended once nobody is left, and a PI owner stops
+// inheriting from the waiter. Timer signal blocked.
+void Sync::mutexAbandon(uthread_mutex_t* mutex, int self) {
+  if (WaitQueue::empty(&mutex->waiters)) {
+    __atomic_and_fetch(&mutex->state, ~MUTEX_CONTENDED, __ATOMIC_RELAXED);
+  }
+  if (mutex->kind == UTHREAD_MUTEX_PI) {
+    Scheduler::getThreadById(self - 1)->setPiBlockedOn(nullptr);
+    int owner = MUTEX_OWNER(mutex->state);
+    if (owner != 0) {
+      Scheduler::refreshPriority(Scheduler::getThreadById(owner - 1));
+    }
+  }
+}
+
+// Gives up a mutex held by the running thread, waking or handing it to the longest waiter. Timer signal blocked.
+void Sync::mutexRelease(uthread_mutex_t* mutex) {
+  if (mutex->kind == UTHREAD_MUTEX_PI) {
+    piRelease(mutex);
+    return;
+  }
+  uthread_waiter* next = WaitQueue::pop(&mutex->waiters);
+  int contended = WaitQueue::empty(&mutex->waiters) ? 0 : MUTEX_CONTENDED;
+  if (next == nullptr) {
+    __atomic_store_n(&mutex->state, 0, __ATOMIC_RELEASE);
+  } else if (mutex->kind == UTHREAD_MUTEX_FAIR) {
+    // Direct handoff: the waiter owns the mutex before it even runs, so nobody can barge in.
+    __atomic_store_n(&mutex->state, (next->tid + 1) | contended, __ATOMIC_RELEASE);
+    next->result = WAIT_HANDOFF;
+    Scheduler::unpark(next);
+  } else {
+    __atomic_store_n(&mutex->state, contended, __ATOMIC_RELEASE);
+    Scheduler::unpark(next);
+  }
+}
+
+// Wait morphing: a signalled waiter is not woken to fight for the mutex. If the mutex is held it moves, still
+// parked, onto the mutex's wait queue and is handed the mutex by a later unlock; if it is free it gets the mutex
+// right away. Either way it wakes up owning the mutex. Timer signal blocked.
+void Sync::condRequeue(uthread_cond_t* cond, uthread_waiter* waiter) {
+  uthread_mutex_t* mutex = cond->mutex;
+  int state = __atomic_load_n(&mutex->state, __ATOMIC_RELAXED);
+  if (MUTEX_OWNER(state) == 0) {
+    int contended = WaitQueue::empty(&mutex->waiters) ? 0 : MUTEX_CONTENDED;
+    __atomic_store_n(&mutex->state, (waiter->tid + 1) | contended, __ATOMIC_RELEASE);
+    waiter->result = WAIT_HANDOFF;
+    Scheduler::unpark(waiter);
+    return;
+  }
+  __atomic_store_n(&mutex->state, state | MUTEX_CONTENDED, __ATOMIC_RELAXED);
+  WaitQueue::push(&mutex->waiters, waiter);
+  if (mutex->kind == UTHREAD_MUTEX_PI) {
+    piQueued(mutex, waiter->tid);
+  }
+}
+
+// A thread was just queued on a held PI mutex: the mutex goes on its owner's list of contended PI mutexes, and the
+// owner, and whoever that owner waits for in turn, inherits the waiter's priority. Timer signal blocked.
+void Sync::piQueued(uthread_mutex_t* mutex, int waiterTid) {
+  Scheduler::getThreadById(waiterTid)->setPiBlockedOn(mutex);
+  Thread* owner = Scheduler::getThreadById(MUTEX_OWNER(mutex->state) - 1);
+  uthread_mutex_t* held = owner->getPiHeld();
+  while (held != nullptr && held != mutex) {
+    held = held->pi_next;
+  }
+  if (held == nullptr) {
+    mutex->pi_next = owner->getPiHeld();
+    owner->setPiHeld(mutex);
+  }
+  Scheduler::refreshPriority(owner);
+}
+
+// Hands a PI mutex to its highest priority waiter, FIFO among equals. The new owner inherits from the waiters
+// still queued and the old one drops back to what it inherits elsewhere. Timer signal blocked.
+void Sync::piRelease(uthread_mutex_t* mutex) {
+  Thread* owner = Scheduler::getThreadById(MUTEX_OWNER(mutex->state) - 1);
+  uthread_mutex_t* prevHeld = nullptr;
+  for (uthread_mutex_t* held = owner->getPiHeld(); held != nullptr; prevHeld = held, held = held->pi_next) {
+    if (held == mutex) {
+      if (prevHeld == nullptr) {
+        owner->setPiHeld(held->pi_next);
+      } else {
+        prevHeld->pi_next = held->pi_next;
+      }
+      break;
+    }
+  }
+  mutex->pi_next = nullptr;
+
+  uthread_waiter* best = nullptr;
+  uthread_waiter* bestPrev = nullptr;
+  uthread_waiter* prev = nullptr;
+  for (uthread_waiter* waiter = mutex->waiters.head; waiter != nullptr; prev = waiter, waiter = waiter->next) {
+    if (best == nullptr ||
+        Scheduler::getThreadById(waiter->tid)->getPriority() > Scheduler::getThreadById(best->tid)->getPriority()) {
+      best = waiter;
+      bestPrev = prev;
+    }
+  }
+  if (best == nullptr) {
+    __atomic_store_n(&mutex->state, 0, __ATOMIC_RELEASE);
+    Scheduler::refreshPriority(owner);
+    return;
+  }
+  WaitQueue::unlink(&mutex->waiters, bestPrev, best);
+
+  Thread* heir = Scheduler::getThreadById(best->tid);
+  heir->setPiBlockedOn(nullptr);
+  bool contended = !WaitQueue::empty(&mutex->waiters);
+  __atomic_store_n(&mutex->state, (best->tid + 1) | (contended ? MUTEX_CONTENDED : 0), __ATOMIC_RELEASE);
+  if (contended) {
+    mutex->pi_next = heir->getPiHeld();
+    heir->setPiHeld(mutex);
+  }
+  Scheduler::refreshPriority(heir);
+  Scheduler::refreshPriority(owner);
+  best->result = WAIT_HANDOFF;
+  Scheduler::unpark(best);
+}
+
+// Stores a new rwlock state, with RWLOCK_WAITERS set for as long as either queue is non-empty so that the fast
+// paths never bypass a queued thread. Timer signal blocked.
+void Sync::rwlockSetState(uthread_rwlock_t* rwlock, int state) {
+  if (!WaitQueue::empty(&rwlock->readers) || !WaitQueue::empty(&rwlock->writers)) {
+    state |= RWLOCK_WAITERS;
+  }
+  __atomic_store_n(&rwlock->state, state, __ATOMIC_RELEASE);
+}
+
+// A queued thread gave up. If it was the last writer waiting while readers hold the lock, the readers queued
+// behind it can come in now. Timer signal blocked.
+void Sync::rwlockAbandon(uthread_rwlock_t* rwlock) {
+  int state = __atomic_load_n(&rwlock->state, __ATOMIC_RELAXED) & ~RWLOCK_WAITERS;
+  if (!(state & RWLOCK_WRITER) && WaitQueue::empty(&rwlock->writers)) {
+    state += Scheduler::unparkAll(&rwlock->readers, WAIT_HANDOFF);
+  }
+  rwlockSetState(rwlock, state);
+}
+
+int Sync::rwlockReadSlow(uthread_rwlock_t* rwlock, int self, long long deadline) {
+  Scheduler::blockTimerSignal();
+  if (rwlock->writer == self) {
+    std::cerr << "thread library error: rwlock is already held for writing by the calling thread" << std::endl;
+    Scheduler::unblockTimerSignal();
+    return -1;
+  }
+  int state = __atomic_load_n(&rwlock->state, __ATOMIC_RELAXED);
+  if (!(state & RWLOCK_WRITER) && WaitQueue::empty(&rwlock->writers)) {
+    rwlockSetState(rwlock, RWLOCK_READERS(state) + 1);
+    Scheduler::unblockTimerSignal();
+    return 0;
+  }
+
+  // Queue behind the writer holding the lock or waiting for it; whoever releases the readers counts us in.
+  uthread_waiter& waiter = *Scheduler::takeWaiters(1);
+  Scheduler::addWaiter(&rwlock->readers, &waiter);
+  rwlockSetState(rwlock, state);
+  if (Scheduler::parkCurrent(0, deadline) < 0) {
+    Scheduler::blockTimerSignal();
+    rwlockAbandon(rwlock);
+    Scheduler::unblockTimerSignal();
+    return -1;
+  }
+  if (waiter.result == WAIT_TIMEDOUT) {
+    Scheduler::blockTimerSignal();
+    rwlockAbandon(rwlock);
+    Scheduler::unblockTimerSignal();
+    return 1;
+  }
+  return 0;
+}
+
+int Sync::rwlockWriteSlow(uthread_rwlock_t* rwlock, int self, long long deadline) {
+  Scheduler::blockTimerSignal();
+  if (rwlock->writer == self) {
+    std::cerr << "thread library error: rwlock is already held for writing by the calling thread" << std::endl;
+    Scheduler::unblockTimerSignal();
+    return -1;
+  }
+  int state = __atomic_load_n(&rwlock->state, __ATOMIC_RELAXED);
+  if ((state & ~RWLOCK_WAITERS) == 0) {
+    rwlock->writer = self;
+    rwlockSetState(rwlock, RWLOCK_WRITER);
+    Scheduler::unblockTimerSignal();
+    return 0;
+  }
+
+  uthread_waiter& waiter = *Scheduler::takeWaiters(1);
+  Scheduler::addWaiter(&rwlock->writers, &waiter);
+  rwlockSetState(rwlock, state);
+  if (Scheduler::parkCurrent(0, deadline) < 0) {
+    Scheduler::blockTimerSignal();
+    rwlockAbandon(rwlock);
+    Scheduler::unblockTimerSignal();
+    return -1;
+  }
+  if (waiter.result == WAIT_TIMEDOUT) {
+    Scheduler::blockTimerSignal();
+    rwlockAbandon(rwlock);
+    Scheduler::unblockTimerSignal();
+    return 1;
+  }
+  return 0; // the releasing thread made us the writer
+}
+
+// Passes a lock nobody holds any more on to its waiters: the longest waiting writer gets it alone, otherwise every
+// waiting reader gets it together, released with one bulk enqueue onto READY. Timer signal blocked.
+void Sync::rwlockRelease(uthread_rwlock_t* rwlock) {
+  uthread_waiter* writer = WaitQueue::pop(&rwlock->writers);
+  if (writer != nullptr) {
+    rwlock->writer = writer->tid + 1;
+    rwlockSetState(rwlock, RWLOCK_WRITER);
+    writer->result = WAIT_HANDOFF;
+    Scheduler::unpark(writer);
+    return;
+  }
+  int readers = Scheduler::unparkAll(&rwlock->readers, WAIT_HANDOFF);
+  rwlockSetState(rwlock, readers);
+}
+
+// **************************** Implementation of the Sync API ********************************************************
+int Sync::mutexInit(uthread_mutex_t* mutex, int kind) {
+  if (kind != UTHREAD_MUTEX_FAIR && kind != UTHREAD_MUTEX_BARGING && kind != UTHREAD_MUTEX_PI) {
+    std::cerr << "thread library error: invalid mutex kind" << std::endl;
+    return -1;
+  }
+  mutex->state = 0;
+  mutex->kind = kind;
+  WaitQueue::init(&mutex->waiters);
+  mutex->pi_next = nullptr;
+  return 0;
+}
+
+int Sync::mutexLock(uthread_mutex_t* mutex, long long deadline) {
+  int self = Scheduler::getTid() + 1;
+  int expected = 0;
+  if (__atomic_compare_exchange_n(&mutex->state, &expected, self, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+    return 0;
+  }
+  if (MUTEX_OWNER(expected) == self) {
+    std::cerr << "thread library error: mutex is already held by the calling thread" << std::endl;
+    return -1;
+  }
+  return mutexLockSlow(mutex, self, deadline);
+}
+
+int Sync::mutexTrylock(uthread_mutex_t* mutex) {
+  int self = Scheduler::getTid() + 1;
+  int expected = 0;
+  if (__atomic_compare_exchange_n(&mutex->state, &expected, self, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+    return 0;
+  }
+  if (MUTEX_OWNER(expected) != 0) {
+    return 1;
+  }
+  // Free but contended: a woken barging waiter has not run yet.
+  Scheduler::blockTimerSignal();
+  int result = 1;
+  if (MUTEX_OWNER(mutex->state) == 0) {
+    __atomic_store_n(&mutex->state, self | MUTEX_CONTENDED, __ATOMIC_RELAXED); // relaxed: the timer is blocked
+    result = 0;
+  }
+  Scheduler::unblockTimerSignal();
+  return result;
+}
+
+int Sync::mutexUnlock(uthread_mutex_t* mutex) {
+  int self = Scheduler::getTid() + 1;
+  int expected = self;
+  if (__atomic_compare_exchange_n(&mutex->state, &expected, 0, false, __ATOMIC_RELEASE, __ATOMIC_RELAXED)) {
+    return 0;
+  }
+  if (MUTEX_OWNER(expected) != self) {
+    std::cerr << "thread library error: mutex is not held by the calling thread" << std::endl;
+    return -1;
+  }
+
+  Scheduler::blockTimerSignal();
+  mutexRelease(mutex);
+  Scheduler::unblockTimerSignal();
+  return 0;
+}
+
+int Sync::mutexDestroy(uthread_mutex_t* mutex) {
+  if (MUTEX_OWNER(mutex->state) != 0 || !WaitQueue::empty(&mutex->waiters)) {
+    std::cerr << "thread library error: cannot destroy a mutex that is held or waited on" << std::endl;
+    return -1;
+  }
+  return 0;
+}
+
+int Sync::condInit(uthread_cond_t* cond) {
+  WaitQueue::init(&cond->waiters);
+  cond->mutex = nullptr;
+  return 0;
+}
+
+// Returns 0 when signalled and 1 when the timeout expired; the mutex is held again on return either way.
+int Sync::condWait(uthread_cond_t* cond, uthread_mutex_t* mutex, int timeoutQuantums, long long deadline) {
+  int self = Scheduler::getTid() + 1;
+  Scheduler::blockTimerSignal();
+  if (MUTEX_OWNER(mutex->state) != self) {
+    std::cerr << "thread library error: mutex is not held by the calling thread" << std::endl;
+    Scheduler::unblockTimerSignal();
+    return -1;
+  }
+  if (cond->mutex != nullptr && cond->mutex != mutex && !WaitQueue::empty(&cond->waiters)) {
+    std::cerr << "thread library error: condition variable is used with two different mutexes" << std::endl;
+    Scheduler::unblockTimerSignal();
+    return -1;
+  }
+  cond->mutex = mutex;
+
+  uthread_waiter& waiter = *Scheduler::takeWaiters(1);
+  Scheduler::addWaiter(&cond->waiters, &waiter);
+  mutexRelease(mutex);
+  if (Scheduler::parkCurrent(timeoutQuantums, deadline) < 0) {
+    mutexLock(mutex);
+    return -1;
+  }
+  // Taking the mutex below parks with the same waiter again.
+  int result = waiter.result;
+  if (result == WAIT_HANDOFF) {
+    return 0;
+  }
+  if (result == WAIT_TIMEDOUT) {
+    // It may have timed out after being moved onto the mutex's queue.
+    Scheduler::blockTimerSignal();
+    mutexAbandon(mutex, self);
+    Scheduler::unblockTimerSignal();
+  }
+  // Timed out, or a barging mutex woke us without ownership: take the mutex the normal way.
+  if (mutexLock(mutex) < 0) {
+    return -1;
+  }
+  return result == WAIT_TIMEDOUT ? 1 : 0;
+}
+
+int Sync::condSignal(uthread_cond_t* cond) {
+  Scheduler::blockTimerSignal();
+  uthread_waiter* waiter = WaitQueue::pop(&cond->waiters);
+  if (waiter != nullptr) {
+    condRequeue(cond, waiter);
+  }
+  Scheduler::unblockTimerSignal();
+  return 0;
+}
+
+int Sync::condBroadcast(uthread_cond_t* cond) {
+  Scheduler::blockTimerSignal();
+  uthread_waiter* waiter;
+  while ((waiter = WaitQueue::pop(&cond->waiters)) != nullptr) {
+    condRequeue(cond, waiter);
+  }
+  Scheduler::unblockTimerSignal();
+  return 0;
+}
+
+int Sync::condDestroy(uthread_cond_t* cond) {
+  if (!WaitQueue::empty(&cond->waiters)) {
+    std::cerr << "thread library error: cannot destroy a condition variable that is waited on" << std::endl;
+    return -1;
+  }
+  return 0;
+}
+
+int Sync::rwlockInit(uthread_rwlock_t* rwlock) {
+  rwlock->state = 0;
+  rwlock->writer = 0;
+  WaitQueue::init(&rwlock->readers);
+  WaitQueue::init(&rwlock->writers);
+  return 0;
+}
+
+int Sync::rwlockRdlock(uthread_rwlock_t* rwlock, long long deadline) {
+  int state = __atomic_load_n(&rwlock->state, __ATOMIC_RELAXED);
+  while (!(state & (RWLOCK_WRITER | RWLOCK_WAITERS))) {
+    if (__atomic_compare_exchange_n(&rwlock->state, &state, state + 1, true, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+      return 0;
+    }
+  }
+  return rwlockReadSlow(rwlock, Scheduler::getTid() + 1, deadline);
+}
+
+int Sync::rwlockWrlock(uthread_rwlock_t* rwlock, long long deadline) {
+  int self = Scheduler::getTid() + 1;
+  int expected = 0;
+  if (__atomic_compare_exchange_n(&rwlock->state, &expected, RWLOCK_WRITER, false, __ATOMIC_ACQUIRE,
+                                  __ATOMIC_RELAXED)) {
+    rwlock->writer = self;
+    return 0;
+  }
+  return rwlockWriteSlow(rwlock, self, deadline);
+}
+
+int Sync::rwlockUnlock(uthread_rwlock_t* rwlock) {
+  int self = Scheduler::getTid() + 1;
+  int state = __atomic_load_n(&rwlock->state, __ATOMIC_RELAXED);
+  if (state & RWLOCK_WRITER) {
+    if (rwlock->writer != self) {
+      std::cerr << "thread library error: rwlock is not held by the calling thread" << std::endl;
+      return -1;
+    }
+    Scheduler::blockTimerSignal();
+    rwlock->writer = 0;
+    rwlockRelease(rwlock);
+    Scheduler::unblockTimerSignal();
+    return 0;
+  }
+
+  if (RWLOCK_READERS(state) == 0) {
+    std::cerr << "thread library error: rwlock is not held by the calling thread" << std::endl;
+    return -1;
+  }
+  while (!(state & RWLOCK_WAITERS)) {
+    if (__atomic_compare_exchange_n(&rwlock->state, &state, state - 1, true, __ATOMIC_RELEASE, __ATOMIC_RELAXED)) {
+      return 0;
+    }
+  }
+  // Threads are queued, which while readers hold the lock means a writer is: the last reader out hands over.
+  Scheduler::blockTimerSignal();
+  int readers = RWLOCK_READERS(__atomic_load_n(&rwlock->state, __ATOMIC_RELAXED)) - 1;
+  if (readers == 0) {
+    rwlockRelease(rwlock);
+  } else {
+    rwlockSetState(rwlock, readers);
+  }
+  Scheduler::unblockTimerSignal();
+  return 0;
+}
+
+int Sync::rwlockDestroy(uthread_rwlock_t* rwlock) {
+  if (rwlock->state != 0 || !WaitQueue::empty(&rwlock->readers) || !WaitQueue::empty(&rwlock->writers)) {
+    std::cerr << "thread library error: cannot destroy a rwlock that is held or waited on" << std::endl;
+    return -1;
+  }
+  return 0;
+}
+
+int Sync::waitgroupInit(uthread_waitgroup_t* wg, int count) {
+  wg->count = count;
+  WaitQueue::init(&wg->waiters);
+  return 0;
+}
+
+int Sync::waitgroupAdd(uthread_waitgroup_t* wg, int delta) {
+  Scheduler::blockTimerSignal();
+  if (wg->count + delta < 0) {
+    std::cerr << "thread library error: wait group count cannot be negative" << std::endl;
+    Scheduler::unblockTimerSignal();
+    return -1;
+  }
+  wg->count += delta;
+  if (wg->count == 0) {
+    Scheduler::unparkAll(&wg->waiters, WAIT_WOKEN);
+  }
+  Scheduler::unblockTimerSignal();
+  return 0;
+}
+
+// Returns 1 if the deadline passed first.
+int Sync::waitgroupWait(uthread_waitgroup_t* wg, long long deadline) {
+  Scheduler::blockTimerSignal();
+  if (wg->count == 0) {
+    Scheduler::unblockTimerSignal();
+    return 0;
+  }
+  uthread_waiter& waiter = *Scheduler::takeWaiters(1);
+  Scheduler::addWaiter(&wg->waiters, &waiter);
+  if (Scheduler::parkCurrent(0, deadline) < 0) {
+    return -1;
+  }
+  return waiter.result == WAIT_TIMEDOUT ? 1 : 0;
+}
+
+int Sync::semInit(uthread_sem_t* sem, int value) {
+  sem->value = value;
+  sem->waiters = 0;
+  return 0;
+}
+
+// Returns 1 if the deadline passed without a unit becoming available.
+int Sync::semWait(uthread_sem_t* sem, long long deadline) {
+  int value = __atomic_load_n(&sem->value, __ATOMIC_RELAXED);
+  while (true) {
+    if (value > 0) {
+      if (__atomic_compare_exchange_n(&sem->value, &value, value - 1, true, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+        return 0;
+      }
+      continue;
+    }
+    // Announce ourselves before sleeping so a post knows to wake someone; a post in between makes the wait
+    // return at once.
+    __atomic_add_fetch(&sem->waiters, 1, __ATOMIC_RELAXED);
+    int result = Futex::wait(&sem->value, 0, 0, deadline);
+    __atomic_sub_fetch(&sem->waiters, 1, __ATOMIC_RELAXED);
+    if (result < 0) {
+      return -1;
+    }
+    if (result == 2) {
+      return semTrywait(sem); // a post may have come in just as the deadline passed
+    }
+    value = __atomic_load_n(&sem->value, __ATOMIC_RELAXED);
+  }
+}
+
+int Sync::semTrywait(uthread_sem_t* sem) {
+  int value = __atomic_load_n(&sem->value, __ATOMIC_RELAXED);
+  while (value > 0) {
+    if (__atomic_compare_exchange_n(&sem->value, &value, value - 1, true, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+      return 0;
+    }
+  }
+  return 1;
+}
+
+int Sync::semPost(uthread_sem_t* sem) {
+  __atomic_add_fetch(&sem->value, 1, __ATOMIC_RELEASE);
+  if (__atomic_load_n(&sem->waiters, __ATOMIC_RELAXED) > 0) {
+    Futex::wake(&sem->value, 1);
+  }
+  return 0;
+}
+
+int Sync::barrierInit(uthread_barrier_t* barrier, int count) {
+  barrier->count = count;
+  barrier->arrived = 0;
+  barrier->generation = 0;
+  return 0;
+}
+
+// Threads wait for the generation to move on rather than for the arrival count, so a thread that leaves and
+// reaches the barrier again before the others have woken up counts towards the next round, not this one.
+int Sync::barrierWait(uthread_barrier_t* barrier) {
+  int generation = __atomic_load_n(&barrier->generation, __ATOMIC_ACQUIRE);
+  if (__atomic_add_fetch(&barrier->arrived, 1, __ATOMIC_ACQ_REL) == barrier->count) {
+    __atomic_store_n(&barrier->arrived, 0, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&barrier->generation, 1, __ATOMIC_RELEASE);
+    Futex::wake(&barrier->generation, INT_MAX);
+    return UTHREAD_BARRIER_SERIAL_THREAD;
+  }
+  while (__atomic_load_n(&barrier->generation, __ATOMIC_ACQUIRE) == generation) {
+    if (Futex::wait(&barrier->generation, generation, 0) < 0) {
+      return -1;
+    }
+  }
+  return 0;
+}
+
+int Sync::eventInit(uthread_event_t* event) {
+  event->set = 0;
+  return 0;
+}
+
+int Sync::eventSet(uthread_event_t* event) {
+  __atomic_store_n(&event->set, 1, __ATOMIC_RELEASE);
+  Futex::wake(&event->set, INT_MAX);
+  return 0;
+}
+
+// Returns 1 if the deadline passed before the event was set.
+int Sync::eventWait(uthread_event_t* event, long long deadline) {
+  while (__atomic_load_n(&event->set, __ATOMIC_ACQUIRE) == 0) {
+    int result = Futex::wait(&event->set, 0, 0, deadline);
+    if (result < 0) {
+      return -1;
+    }
+    if (result == 2) {
+      return __atomic_load_n(&event->set, __ATOMIC_ACQUIRE) == 0 ? 1 : 0;
+    }
+  }
+  return 0;
+}
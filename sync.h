@@ -0,0 +1,70 @@
+//
+// Blocking synchronization primitives built on the scheduler's wait queues.
+//
+
+#ifndef _SYNC_H_
+#define _SYNC_H_
+
+#include "uthreads.h"
+
+// Set in uthread_mutex_t::state while threads wait, so unlock takes the slow path and wakes one of them.
+#define MUTEX_CONTENDED 0x40000000
+#define MUTEX_OWNER(state) ((state) & ~MUTEX_CONTENDED)
+
+// uthread_rwlock_t::state flags. Either one sends readers down the slow path.
+#define RWLOCK_WRITER 0x40000000
+#define RWLOCK_WAITERS 0x20000000
+#define RWLOCK_READERS(state) ((state) & ~(RWLOCK_WRITER | RWLOCK_WAITERS))
+
+class Sync {
+private:
+    static int mutexLockSlow(uthread_mutex_t* mutex, int self, long long deadline);
+    static void mutexAbandon(uthread_mutex_t* mutex, int self);
+    static void mutexRelease(uthread_mutex_t* mutex);
+    static void condRequeue(uthread_cond_t* cond, uthread_waiter* waiter);
+    static void piQueued(uthread_mutex_t* mutex, int waiterTid);
+    static void piRelease(uthread_mutex_t* mutex);
+    static void rwlockSetState(uthread_rwlock_t* rwlock, int state);
+    static void rwlockAbandon(uthread_rwlock_t* rwlock);
+    static int rwlockReadSlow(uthread_rwlock_t* rwlock, int self, long long deadline);
+    static int rwlockWriteSlow(uthread_rwlock_t* rwlock, int self, long long deadline);
+    static void rwlockRelease(uthread_rwlock_t* rwlock);
+
+public:
+    static int mutexInit(uthread_mutex_t* mutex, int kind);
+    static int mutexLock(uthread_mutex_t* mutex, long long deadline = 0);
+    static int mutexTrylock(uthread_mutex_t* mutex);
+    static int mutexUnlock(uthread_mutex_t* mutex);
+    static int mutexDestroy(uthread_mutex_t* mutex);
+
+    static int condInit(uthread_cond_t* cond);
+    static int condWait(uthread_cond_t* cond, uthread_mutex_t* mutex, int timeoutQuantums, long long deadline = 0);
+    static int condSignal(uthread_cond_t* cond);
+    static int condBroadcast(uthread_cond_t* cond);
+    static int condDestroy(uthread_cond_t* cond);
+
+    static int rwlockInit(uthread_rwlock_t* rwlock);
+    static int rwlockRdlock(uthread_rwlock_t* rwlock, long long deadline = 0);
+    static int rwlockWrlock(uthread_rwlock_t* rwlock, long long deadline = 0);
+    static int rwlockUnlock(uthread_rwlock_t* rwlock);
+    static int rwlockDestroy(uthread_rwlock_t* rwlock);
+
+    static int waitgroupInit(uthread_waitgroup_t* wg, int count);
+    static int waitgroupAdd(uthread_waitgroup_t* wg, int delta);
+    static int waitgroupWait(uthread_waitgroup_t* wg, long long deadline = 0);
+
+    // Built purely on Futex, the way a library user would build their own.
+    static int semInit(uthread_sem_t* sem, int value);
+    static int semWait(uthread_sem_t* sem, long long deadline = 0);
+    static int semTrywait(uthread_sem_t* sem);
+    static int semPost(uthread_sem_t* sem);
+
+    static int barrierInit(uthread_barrier_t* barrier, int count);
+    static int barrierWait(uthread_barrier_t* barrier);
+
+    static int eventInit(uthread_event_t* event);
+    static int eventSet(uthread_event_t* event);
+    static int eventWait(uthread_event_t* event, long long deadline = 0);
+};
+
+#endif //_SYNC_H_
@@ -0,0 +1,244 @@
+#include "sysmon.h"
+#include "scheduler.h"
+#include "thread.h"
+#include <algorithm>
+#include <iostream>
+#include <sys/time.h>
+
+// Consecutive idle monitor rounds before the monitor starts backing off its polling interval.
+#define MONITOR_IDLE_ROUNDS 50
+
+// Static variables initialization
+pthread_mutex_t SysMon::lock = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t SysMon::carrierCv = PTHREAD_COND_INITIALIZER;
+pthread_cond_t SysMon::monitorCv = PTHREAD_COND_INITIALIZER;
+TokenState SysMon::tokenState = TOKEN_OWNED;
+Carrier* SysMon::syscallCarrier = nullptr;
+int SysMon::syscallTid = -1;
+std::chrono::steady_clock::time_point SysMon::syscallSince;
+std::atomic<int> SysMon::returners(0);
+int SysMon::idleSpares = 0;
+int SysMon::spareCount = 0;
+int SysMon::thresholdUsecs = 0;
+int SysMon::monitorNapUsecs = 0;
+bool SysMon::monitorStarted = false;
+Carrier SysMon::mainCarrier = {};
+thread_local Carrier* SysMon::current = nullptr;
+
+//************************* Implementation of the private functions ****************************************************
+// The kernel thread that called uthread_init never sets its own pointer.
+Carrier* SysMon::self() {
+  return current != nullptr ? current : &mainCarrier;
+}
+
+// Polls the token while a blocking region is open, and backs off to MONITOR_MAX_NAP_USECS when none has been
+// seen for a while so an idle process does not pay for the monitor.
+void* SysMon::monitorLoop(void*) {
+  pthread_mutex_lock(&lock);
+  int idleRounds = 0;
+  monitorNapUsecs = MONITOR_MAX_NAP_USECS;
+  while (true) {
+    struct timeval now{};
+    gettimeofday(&now, nullptr);
+    long usecs = now.tv_usec + monitorNapUsecs;
+    struct timespec until{};
+    until.tv_sec = now.tv_sec + usecs / 1000000;
+    until.tv_nsec = (usecs % 1000000) * 1000;
+    pthread_cond_timedwait(&monitorCv, &lock, &until);
+    if (thresholdUsecs == 0 || tokenState != TOKEN_SYSCALL) {
+      if (++idleRounds >= MONITOR_IDLE_ROUNDS) {
+        monitorNapUsecs = std::min(monitorNapUsecs * 2, MONITOR_MAX_NAP_USECS);
+      }
+      continue;
+    }
+    idleRounds = 0;
+    monitorNapUsecs = std::max(thresholdUsecs / 2, 1);
+
+    auto stuck = std::chrono::steady_clock::now() - syscallSince;
+    if (stuck < std::chrono::microseconds(thresholdUsecs)) {
+      continue;
+    }
+    // Only worth it if someone can use the token.
+    if (returners.load() > 0 || Scheduler::hasReadyThreads()) {
+      retake();
+    }
+  }
+}
+
+// Takes the token from a carrier stuck in a blocking region. A carrier waiting to come back from its own region
+// gets it first, otherwise an idle spare, starting one if needed. Called with the lock held.
+void SysMon::retake() {
+  bool toReturner = returners.load() > 0;
+  if (!toReturner && idleSpares == 0) {
+    if (spareCount >= MAX_SPARE_CARRIERS) {
+      return;
+    }
+    spareCount++;
+    startCarrierThread(spareMain);
+  }
+  Scheduler::markHandedOff(syscallTid);
+  tokenState = toReturner ? TOKEN_GRANTED : TOKEN_HANDOFF;
+  pthread_cond_broadcast(&carrierCv);
+}
+
+// Carriers start with every signal blocked: signals only ever reach them through the mask of the uthread they run.
+void SysMon::startCarrierThread(void* (*routine)(void*)) {
+  sigset_t all, old;
+  sigfillset(&all);
+  pthread_sigmask(SIG_SETMASK, &all, &old);
+  pthread_t thread;
+  if (pthread_create(&thread, nullptr, routine, nullptr) != 0) {
+    std::cerr << "system error: cannot create carrier thread" << std::endl;
+    exit(1);
+  }
+  pthread_sigmask(SIG_SETMASK, &old, nullptr);
+  pthread_detach(thread);
+}
+
+// Spare carriers inherit a mask blocking every signal from the monitor, so their home mask keeps them blocked.
+void* SysMon::spareMain(void*) {
+  Carrier* carrier = new Carrier();
+  current = carrier;
+  Scheduler::setupCarrierStack();
+  bool handingBack = sigsetjmp(carrier->home, 1) != 0;
+  parkCarrier(handingBack);
+  return nullptr;
+}
+
+// Home of the main carrier. The context is rebuilt from scratch on every jump, so it only starts when giving
+// the token back.
+void SysMon::mainCarrierHome() {
+  parkCarrier(true);
+}
+
+// Runs on the carrier's home stack, never on a uthread stack, so the thread it last ran can be resumed elsewhere.
+void SysMon::parkCarrier(bool handingBack) {
+  pthread_mutex_lock(&lock);
+  if (handingBack) {
+    tokenState = TOKEN_GRANTED;
+    pthread_cond_broadcast(&carrierCv);
+  }
+  idleSpares++;
+  while (tokenState != TOKEN_HANDOFF) {
+    pthread_cond_wait(&carrierCv, &lock);
+  }
+  idleSpares--;
+  tokenState = TOKEN_OWNED;
+  pthread_mutex_unlock(&lock);
+  Scheduler::dispatchFromCarrier();
+}
+
+// **************************** Implementation of the SysMon API ******************************************************
+int SysMon::setHandoff(int threshold) {
+  Scheduler::blockTimerSignal();
+  pthread_mutex_lock(&lock);
+  if (threshold > 0 && Thread::isSharedStack()) {
+    // A thread stuck in the kernel keeps its frames on the shared stack, which the spare would need.
+    std::cerr << "thread library error: syscall handoff cannot be used in shared-stack mode" << std::endl;
+    pthread_mutex_unlock(&lock);
+    Scheduler::unblockTimerSignal();
+    return -1;
+  }
+  thresholdUsecs = threshold;
+  if (threshold > 0 && !monitorStarted) {
+    mainCarrier.homeStack = new(std::nothrow) char[CARRIER_STACK_SIZE];
+    if (mainCarrier.homeStack == nullptr) {
+      std::cerr << "system error: cannot allocate carrier stack" << std::endl;
+      exit(1);
+    }
+    Thread::setupContext(mainCarrier.home, mainCarrier.homeStack, CARRIER_STACK_SIZE, mainCarrierHome);
+    sigaddset(&mainCarrier.home->__saved_mask, SIGVTALRM);
+
+    // Started with the timer signal blocked, which the monitor and every spare it starts inherit.
+    startCarrierThread(monitorLoop);
+    monitorStarted = true;
+  }
+  pthread_cond_signal(&monitorCv);
+  pthread_mutex_unlock(&lock);
+  Scheduler::unblockTimerSignal();
+  return 0;
+}
+
+bool SysMon::handoffEnabled() {
+  pthread_mutex_lock(&lock);
+  bool enabled = thresholdUsecs > 0;
+  pthread_mutex_unlock(&lock);
+  return enabled;
+}
+
+int SysMon::enterBlocking() {
+  Scheduler::blockTimerSignal();
+  Carrier* carrier = self();
+  if (carrier->inBlocking) {
+    std::cerr << "thread library error: already inside a blocking region" << std::endl;
+    Scheduler::unblockTimerSignal();
+    return -1;
+  }
+  if (thresholdUsecs == 0) {
+    Scheduler::unblockTimerSignal();
+    return 0;
+  }
+
+  pthread_mutex_lock(&lock);
+  carrier->inBlocking = true;
+  carrier->blockingTid = Scheduler::getTid();
+  syscallCarrier = carrier;
+  syscallTid = carrier->blockingTid;
+  syscallSince = std::chrono::steady_clock::now();
+  tokenState = TOKEN_SYSCALL;
+  if (monitorNapUsecs > thresholdUsecs) {
+    pthread_cond_signal(&monitorCv);
+  }
+  pthread_mutex_unlock(&lock);
+  // The timer signal stays blocked on this carrier until exitBlocking: it may lose the token meanwhile.
+  return 0;
+}
+
+int SysMon::exitBlocking() {
+  Carrier* carrier = self();
+  if (!carrier->inBlocking) {
+    return 0;
+  }
+  carrier->inBlocking = false;
+
+  pthread_mutex_lock(&lock);
+  if (tokenState == TOKEN_SYSCALL && syscallCarrier == carrier) {
+    // Fast path: nobody took the token while we were in the kernel.
+    tokenState = TOKEN_OWNED;
+    pthread_mutex_unlock(&lock);
+    Scheduler::unblockTimerSignal();
+    return 0;
+  }
+
+  // Retaken. If no spare has claimed it yet just take it back, otherwise wait for the carrier running the
+  // scheduler to give it back at its next scheduling point.
+  if (tokenState != TOKEN_HANDOFF || syscallCarrier != carrier) {
+    returners++;
+    while (tokenState != TOKEN_GRANTED) {
+      pthread_cond_wait(&carrierCv, &lock);
+    }
+    returners--;
+  }
+  tokenState = TOKEN_OWNED;
+  pthread_mutex_unlock(&lock);
+
+  Scheduler::resumeFromSyscall(carrier->blockingTid);
+  Scheduler::unblockTimerSignal();
+  return 0;
+}
+
+bool SysMon::returnerWaiting() {
+  return returners.load(std::memory_order_relaxed) > 0;
+}
+
+// Called at a scheduling point once the current thread is saved. Does not return.
+void SysMon::handBack() {
+  siglongjmp(self()->home, 1);
+}
+
+// The spares' homes block every signal already; only the main carrier's home, built before, needs the new ones.
+void SysMon::blockInHomes(const sigset_t* set) {
+  if (monitorStarted) {
+    sigorset(&mainCarrier.home->__saved_mask, &mainCarrier.home->__saved_mask, set);
+  }
+}
@@ -0,0 +1,78 @@
+//
+// Syscall handoff monitor.
+//
+// Every uthread runs on the kernel thread ("carrier") that holds the scheduler token, so a uthread blocked in the
+// kernel stalls all the others. A uthread that brackets a slow call with uthread_enter_blocking() and
+// uthread_exit_blocking() lets the monitor thread take the token away from its carrier once the call has been
+// in the kernel longer than the configured threshold, and hand it to a spare carrier that keeps running the READY
+// threads. When the call returns the original carrier waits for the token to come back at the next scheduling
+// point and resumes its thread, then parks as a spare itself.
+//
+
+#ifndef _SYSMON_H_
+#define _SYSMON_H_
+
+#include <setjmp.h>
+#include <signal.h>
+#include <pthread.h>
+#include <atomic>
+#include <chrono>
+
+#define CARRIER_STACK_SIZE 65536  /* private stack the main carrier parks on */
+#define MAX_SPARE_CARRIERS 16     /* spare kernel threads the monitor may start */
+#define MONITOR_MAX_NAP_USECS 10000
+
+// A kernel thread that runs uthreads while it holds the scheduler token.
+struct Carrier {
+    sigjmp_buf home;        // where the carrier parks after giving the token away
+    char* homeStack;        // stack of a synthetic home context, null when home is on the pthread stack
+    bool inBlocking;        // between uthread_enter_blocking and uthread_exit_blocking
+    int blockingTid;        // thread that entered the blocking region
+};
+
+// Who may run the scheduler right now.
+enum TokenState {
+    TOKEN_OWNED,    // a carrier is running uthreads
+    TOKEN_SYSCALL,  // the owner is inside a blocking region and may be retaken
+    TOKEN_HANDOFF,  // retaken for a spare carrier
+    TOKEN_GRANTED   // retaken or given back for a carrier returning from a blocking region
+};
+
+class SysMon {
+private:
+    static void* monitorLoop(void* arg);
+    static void* spareMain(void* arg);
+    static void startCarrierThread(void* (*routine)(void*));
+    static void mainCarrierHome();
+    static void parkCarrier(bool handingBack);
+    static void retake();
+    static Carrier* self();
+
+    // Plain pthread objects: they have no destructors to race with a carrier still parked at process exit.
+    static pthread_mutex_t lock;
+    static pthread_cond_t carrierCv;
+    static pthread_cond_t monitorCv;
+    static TokenState tokenState;
+    static Carrier* syscallCarrier;
+    static int syscallTid;
+    static std::chrono::steady_clock::time_point syscallSince;
+    static std::atomic<int> returners;
+    static int idleSpares;
+    static int spareCount;
+    static int thresholdUsecs;
+    static int monitorNapUsecs;
+    static bool monitorStarted;
+    static Carrier mainCarrier;
+    static thread_local Carrier* current;
+
+public:
+    static int setHandoff(int threshold);
+    static bool handoffEnabled();
+    static int enterBlocking();
+    static int exitBlocking();
+    static bool returnerWaiting();
+    static void handBack();
+    static void blockInHomes(const sigset_t* set);
+};
+
+#endif //_SYSMON_H_
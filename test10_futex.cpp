@@ -0,0 +1,134 @@
+/*
+ * test10 - Wait-on-address and the primitives built on it: a semaphore bounding concurrency, a barrier keeping
+ * threads in lockstep over several rounds, a one-shot event, and a hand-rolled latch on uthread_wait_on.
+ *
+ * Output should be:
+ * semaphore: 6 threads, at most 2 inside
+ * barrier: 5 rounds, out of step: 0, serial threads: 5
+ * event: 3 waiters released
+ * latch: woken with value 3
+ */
+
+#include <stdio.h>
+#include "uthreads.h"
+
+#define THREADS 6
+#define PERMITS 2
+#define PARTIES 4
+#define ROUNDS 5
+
+uthread_sem_t permits = UTHREAD_SEM_INITIALIZER(PERMITS);
+int inside = 0;
+int maxInside = 0;
+uthread_waitgroup_t done = UTHREAD_WAITGROUP_INITIALIZER;
+
+void limited()
+{
+    for (int i = 0; i < 5; i++)
+    {
+        uthread_sem_wait(&permits);
+        inside++;
+        if (inside > maxInside)
+        {
+            maxInside = inside;
+        }
+        // Hold the permit across a yield, so every other thread gets to try the semaphore meanwhile.
+        uthread_yield();
+        inside--;
+        uthread_sem_post(&permits);
+    }
+    uthread_waitgroup_done(&done);
+}
+
+uthread_barrier_t barrier;
+int phase[PARTIES];
+int outOfStep = 0;
+int serial = 0;
+int nextParty = 0;
+
+void party()
+{
+    int me = nextParty++;
+    for (int round = 0; round < ROUNDS; round++)
+    {
+        phase[me] = round;
+        for (volatile int spin = 0; spin < 10000 * (me + 1); spin++)
+        {
+        }
+        if (uthread_barrier_wait(&barrier) == UTHREAD_BARRIER_SERIAL_THREAD)
+        {
+            serial++;
+        }
+        for (int other = 0; other < PARTIES; other++)
+        {
+            if (phase[other] < round)
+            {
+                outOfStep++;
+            }
+        }
+        uthread_barrier_wait(&barrier);
+    }
+    uthread_waitgroup_done(&done);
+}
+
+uthread_event_t go = UTHREAD_EVENT_INITIALIZER;
+int released = 0;
+
+void eventWaiter()
+{
+    uthread_event_wait(&go);
+    released++;
+    uthread_waitgroup_done(&done);
+}
+
+int arrivals = 0;
+
+void arrive()
+{
+    __atomic_add_fetch(&arrivals, 1, __ATOMIC_RELEASE);
+    uthread_wake(&arrivals, 1);
+}
+
+int main()
+{
+    uthread_init(100);
+    uthread_waitgroup_init(&done, THREADS);
+    for (int i = 0; i < THREADS; i++)
+    {
+        uthread_spawn(limited);
+    }
+    uthread_waitgroup_wait(&done);
+    printf("semaphore: %d threads, at most %d inside\n", THREADS, maxInside);
+
+    uthread_barrier_init(&barrier, PARTIES);
+    uthread_waitgroup_init(&done, PARTIES);
+    for (int i = 0; i < PARTIES; i++)
+    {
+        uthread_spawn(party);
+    }
+    uthread_waitgroup_wait(&done);
+    printf("barrier: %d rounds, out of step: %d, serial threads: %d\n", ROUNDS, outOfStep, serial);
+
+    uthread_waitgroup_init(&done, 3);
+    for (int i = 0; i < 3; i++)
+    {
+        uthread_spawn(eventWaiter);
+    }
+    uthread_event_set(&go);
+    uthread_waitgroup_wait(&done);
+    printf("event: %d waiters released\n", released);
+
+    // A latch written directly on wait-on-address: sleep until three arrivals were counted.
+    for (int i = 0; i < 3; i++)
+    {
+        uthread_spawn(arrive);
+    }
+    int seen;
+    while ((seen = __atomic_load_n(&arrivals, __ATOMIC_ACQUIRE)) < 3)
+    {
+        uthread_wait_on(&arrivals, seen);
+    }
+    printf("latch: woken with value %d\n", seen);
+    uthread_terminate(0);
+    return 0;
+}
@@ -0,0 +1,115 @@
+/*
+ * test11 - Priority inheritance: a low priority thread holds a lock a high priority thread needs while medium
+ * priority threads spin. With a plain mutex the medium threads keep the holder from ever running; with a PI mutex
+ * the holder inherits the high priority, through a chain of two locks, and the high priority thread gets in before
+ * the medium threads finish.
+ *
+ * Output should be:
+ * fair: high got the lock after the medium threads finished
+ * pi: high got the lock before the medium threads finished
+ * pi: holder boosted to 9 through the chain, back to 1 after unlocking
+ */
+
+#include <stdio.h>
+#include "uthreads.h"
+
+#define MEDIUM 2
+
+uthread_mutex_t outer;
+uthread_mutex_t inner;
+volatile int mediumDone = 0;
+volatile int highDoneFirst = -1;
+uthread_sem_t lowHolding;
+uthread_sem_t midHolding;
+int boosted = 0;
+int restored = 0;
+int lowTid;
+uthread_waitgroup_t done = UTHREAD_WAITGROUP_INITIALIZER;
+
+void spin(long n)
+{
+    for (volatile long i = 0; i < n; i++)
+    {
+    }
+}
+
+// Priority 1: takes inner, then works for a few quanta holding it. Counting quanta rather than iterations keeps it
+// from finishing inside one coarse virtual timer tick.
+void low()
+{
+    uthread_mutex_lock(&inner);
+    uthread_sem_post(&lowHolding);
+    int until = uthread_get_total_quantums() + 3;
+    while (uthread_get_total_quantums() < until)
+    {
+    }
+    boosted = uthread_get_priority(uthread_get_tid());
+    uthread_mutex_unlock(&inner);
+    restored = uthread_get_priority(uthread_get_tid());
+    uthread_waitgroup_done(&done);
+}
+
+// Priority 5: takes outer, then needs inner, forming the chain high -> mid -> low.
+void mid()
+{
+    uthread_mutex_lock(&outer);
+    uthread_sem_post(&midHolding);
+    uthread_mutex_lock(&inner);
+    uthread_mutex_unlock(&inner);
+    uthread_mutex_unlock(&outer);
+    uthread_waitgroup_done(&done);
+}
+
+// Priority 9: needs outer.
+void high()
+{
+    uthread_mutex_lock(&outer);
+    highDoneFirst = mediumDone < MEDIUM;
+    uthread_mutex_unlock(&outer);
+    uthread_waitgroup_done(&done);
+}
+
+// Priority 3: busy, never blocks.
+void medium()
+{
+    spin(20000000);
+    mediumDone++;
+    uthread_waitgroup_done(&done);
+}
+
+void run(const char *name, int kind)
+{
+    uthread_mutex_init(&outer, kind);
+    uthread_mutex_init(&inner, kind);
+    mediumDone = 0;
+    highDoneFirst = -1;
+    uthread_sem_init(&lowHolding, 0);
+    uthread_sem_init(&midHolding, 0);
+    uthread_waitgroup_init(&done, 3 + MEDIUM);
+
+    lowTid = uthread_spawn(low);
+    uthread_set_priority(lowTid, 1);
+    uthread_sem_wait(&lowHolding);
+    int midTid = uthread_spawn(mid);
+    uthread_set_priority(midTid, 5);
+    uthread_sem_wait(&midHolding);
+    uthread_set_priority(uthread_spawn(high), 9);
+    for (int i = 0; i < MEDIUM; i++)
+    {
+        uthread_set_priority(uthread_spawn(medium), 3);
+    }
+    uthread_waitgroup_wait(&done);
+    printf("%s: high got the lock %s the medium threads finished\n", name, highDoneFirst ? "before" : "after");
+}
+
+int main()
+{
+    uthread_init(100);
+    // Main runs above everyone until it waits, so it can set the scene.
+    uthread_set_priority(0, 10);
+    run("fair", UTHREAD_MUTEX_FAIR);
+    run("pi", UTHREAD_MUTEX_PI);
+    printf("pi: holder boosted to %d through the chain, back to %d after unlocking\n", boosted, restored);
+    uthread_terminate(0);
+    return 0;
+}
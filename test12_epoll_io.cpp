@@ -0,0 +1,122 @@
+/*
+ * test12 - Epoll I/O: an echo server on loopback with one uthread per connection, where every thread blocks only
+ * itself while the library idles in epoll, plus a pipe reader woken after its writer slept.
+ *
+ * Output should be:
+ * echo: 800 messages over 8 connections, all intact: yes
+ * pipe: read "hello" after the writer slept
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include "uthreads.h"
+
+#define CLIENTS 8
+#define MESSAGES 100
+#define MESSAGE_SIZE 64
+
+int listener;
+struct sockaddr_in address;
+int echoed = 0;
+int intact = 1;
+uthread_waitgroup_t done = UTHREAD_WAITGROUP_INITIALIZER;
+
+int readFully(int fd, char *buf, int size)
+{
+    int got = 0;
+    while (got < size)
+    {
+        ssize_t n = uthread_read(fd, buf + got, size - got);
+        if (n <= 0)
+        {
+            return got;
+        }
+        got += n;
+    }
+    return got;
+}
+
+void *handler(void *arg)
+{
+    int fd = (int) (intptr_t) arg;
+    char buf[MESSAGE_SIZE];
+    while (readFully(fd, buf, MESSAGE_SIZE) == MESSAGE_SIZE)
+    {
+        uthread_write(fd, buf, MESSAGE_SIZE);
+    }
+    uthread_close(fd);
+    return NULL;
+}
+
+void acceptor()
+{
+    for (int i = 0; i < CLIENTS; i++)
+    {
+        int fd = uthread_accept(listener, NULL, NULL);
+        uthread_spawn_routine(handler, (void *) (intptr_t) fd);
+    }
+    uthread_waitgroup_done(&done);
+}
+
+void client()
+{
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    connect(fd, (struct sockaddr *) &address, sizeof(address));
+    char out[MESSAGE_SIZE];
+    char in[MESSAGE_SIZE];
+    for (int i = 0; i < MESSAGES; i++)
+    {
+        memset(out, 'a' + (uthread_get_tid() + i) % 26, MESSAGE_SIZE);
+        uthread_write(fd, out, MESSAGE_SIZE);
+        if (readFully(fd, in, MESSAGE_SIZE) != MESSAGE_SIZE || memcmp(in, out, MESSAGE_SIZE) != 0)
+        {
+            intact = 0;
+        }
+        echoed++;
+    }
+    uthread_close(fd);
+    uthread_waitgroup_done(&done);
+}
+
+int pipeFds[2];
+
+void pipeWriter()
+{
+    uthread_sleep(3);
+    uthread_write(pipeFds[1], "hello", 5);
+}
+
+int main()
+{
+    uthread_init(1000);
+    listener = socket(AF_INET, SOCK_STREAM, 0);
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port = 0;
+    bind(listener, (struct sockaddr *) &address, sizeof(address));
+    socklen_t length = sizeof(address);
+    getsockname(listener, (struct sockaddr *) &address, &length);
+    listen(listener, CLIENTS);
+
+    uthread_waitgroup_init(&done, CLIENTS + 1);
+    uthread_spawn(acceptor);
+    for (int i = 0; i < CLIENTS; i++)
+    {
+        uthread_spawn(client);
+    }
+    uthread_waitgroup_wait(&done);
+    printf("echo: %d messages over %d connections, all intact: %s\n", echoed, CLIENTS, intact ? "yes" : "no");
+
+    pipe(pipeFds);
+    uthread_spawn(pipeWriter);
+    char word[6] = {0};
+    readFully(pipeFds[0], word, 5);
+    printf("pipe: read \"%s\" after the writer slept\n", word);
+    uthread_terminate(0);
+    return 0;
+}
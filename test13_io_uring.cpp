@@ -0,0 +1,156 @@
+/*
+ * test13 - io_uring backend: threads write a file with positioned writes and read it back, then echo messages over
+ * socket pairs, all queued on the ring and submitted in batches. Falls back to epoll where io_uring is missing,
+ * with the same output.
+ *
+ * Output should be:
+ * backend selected: yes
+ * file: 128 blocks written and read back, all intact: yes
+ * sockets: 400 messages echoed over 4 pairs, all intact: yes
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include "uthreads.h"
+
+#define THREADS 8
+#define BLOCKS_PER_THREAD 16
+#define BLOCK_SIZE 4096
+#define PAIRS 4
+#define MESSAGES 100
+#define MESSAGE_SIZE 32
+
+int file;
+int intact = 1;
+uthread_waitgroup_t done = UTHREAD_WAITGROUP_INITIALIZER;
+int pairs[PAIRS][2];
+char blocks[THREADS][BLOCK_SIZE];   // a block does not fit on a thread's stack
+
+// Thread i owns blocks i, i + THREADS, i + 2 * THREADS, ... so writes from different threads interleave on disk.
+void *writer(void *arg)
+{
+    int first = (int) (intptr_t) arg;
+    char *block = blocks[first];
+    for (int i = 0; i < BLOCKS_PER_THREAD; i++)
+    {
+        int index = first + i * THREADS;
+        memset(block, 'A' + index % 26, BLOCK_SIZE);
+        if (uthread_pwrite(file, block, BLOCK_SIZE, (off_t) index * BLOCK_SIZE) != BLOCK_SIZE)
+        {
+            intact = 0;
+        }
+    }
+    return NULL;
+}
+
+void *reader(void *arg)
+{
+    int first = (int) (intptr_t) arg;
+    char *block = blocks[first];
+    for (int i = 0; i < BLOCKS_PER_THREAD; i++)
+    {
+        int index = first + i * THREADS;
+        if (uthread_pread(file, block, BLOCK_SIZE, (off_t) index * BLOCK_SIZE) != BLOCK_SIZE ||
+            block[0] != 'A' + index % 26 || block[BLOCK_SIZE - 1] != 'A' + index % 26)
+        {
+            intact = 0;
+        }
+    }
+    return NULL;
+}
+
+void *echo(void *arg)
+{
+    int fd = pairs[(intptr_t) arg][1];
+    char buf[MESSAGE_SIZE];
+    ssize_t n;
+    while ((n = uthread_read(fd, buf, MESSAGE_SIZE)) > 0)
+    {
+        uthread_write(fd, buf, n);
+    }
+    uthread_close(fd);
+    return NULL;
+}
+
+void *talker(void *arg)
+{
+    int fd = pairs[(intptr_t) arg][0];
+    char out[MESSAGE_SIZE];
+    char in[MESSAGE_SIZE];
+    int echoed = 0;
+    for (int i = 0; i < MESSAGES; i++)
+    {
+        snprintf(out, MESSAGE_SIZE, "pair %d message %d", (int) (intptr_t) arg, i);
+        uthread_write(fd, out, MESSAGE_SIZE);
+        int got = 0;
+        while (got < MESSAGE_SIZE)
+        {
+            ssize_t n = uthread_read(fd, in + got, MESSAGE_SIZE - got);
+            if (n <= 0)
+            {
+                break;
+            }
+            got += n;
+        }
+        if (got == MESSAGE_SIZE && memcmp(in, out, MESSAGE_SIZE) == 0)
+        {
+            echoed++;
+        }
+    }
+    uthread_close(fd);
+    return (void *) (intptr_t) echoed;
+}
+
+int main()
+{
+    uthread_init(1000);
+    int backend = uthread_set_io_backend(UTHREAD_IO_URING);
+    printf("backend selected: %s\n", backend == UTHREAD_IO_URING || backend == UTHREAD_IO_EPOLL ? "yes" : "no");
+
+    char path[] = "/tmp/uthreads_test13_XXXXXX";
+    file = mkstemp(path);
+    unlink(path);
+    int tids[THREADS];
+    for (int i = 0; i < THREADS; i++)
+    {
+        tids[i] = uthread_spawn_routine(writer, (void *) (intptr_t) i);
+    }
+    for (int i = 0; i < THREADS; i++)
+    {
+        uthread_join(tids[i], NULL);
+    }
+    for (int i = 0; i < THREADS; i++)
+    {
+        tids[i] = uthread_spawn_routine(reader, (void *) (intptr_t) i);
+    }
+    for (int i = 0; i < THREADS; i++)
+    {
+        uthread_join(tids[i], NULL);
+    }
+    close(file);
+    printf("file: %d blocks written and read back, all intact: %s\n", THREADS * BLOCKS_PER_THREAD,
+           intact ? "yes" : "no");
+
+    int talkers[PAIRS];
+    for (int i = 0; i < PAIRS; i++)
+    {
+        socketpair(AF_UNIX, SOCK_STREAM, 0, pairs[i]);
+        uthread_spawn_routine(echo, (void *) (intptr_t) i);
+        talkers[i] = uthread_spawn_routine(talker, (void *) (intptr_t) i);
+    }
+    int echoed = 0;
+    for (int i = 0; i < PAIRS; i++)
+    {
+        void *result;
+        uthread_join(talkers[i], &result);
+        echoed += (int) (intptr_t) result;
+    }
+    printf("sockets: %d messages echoed over %d pairs, all intact: %s\n", echoed, PAIRS,
+           echoed == PAIRS * MESSAGES ? "yes" : "no");
+    uthread_terminate(0);
+    return 0;
+}
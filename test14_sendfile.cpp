@@ -0,0 +1,172 @@
+/*
+ * test14 - Zero-copy transfers: threads serve a 4 MB file over sockets with uthread_sendfile, and a proxy moves
+ * data between two sockets through a pipe with uthread_splice. The receivers only ever hold small buffers.
+ *
+ * Output should be:
+ * sendfile: 4 clients each got 4194304 bytes, all intact: yes
+ * splice: proxied 1048576 bytes, intact: yes
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include "uthreads.h"
+
+#define CLIENTS 4
+#define FILE_SIZE (4 * 1024 * 1024)
+#define PROXIED (1024 * 1024)
+#define CHUNK 512
+
+int file;
+int connections[CLIENTS][2];
+long received[CLIENTS];
+int intact = 1;
+
+// Byte i of every stream is i % 251, so a receiver can check what it got without a copy of the source.
+char expected(long position)
+{
+    return (char) (position % 251);
+}
+
+void *server(void *arg)
+{
+    int fd = connections[(intptr_t) arg][0];
+    off_t offset = 0;
+    while (offset < FILE_SIZE)
+    {
+        if (uthread_sendfile(fd, file, &offset, FILE_SIZE - offset) <= 0)
+        {
+            break;
+        }
+    }
+    uthread_close(fd);
+    return NULL;
+}
+
+void *client(void *arg)
+{
+    int index = (int) (intptr_t) arg;
+    int fd = connections[index][1];
+    char buf[CHUNK];
+    ssize_t n;
+    while ((n = uthread_read(fd, buf, CHUNK)) > 0)
+    {
+        for (ssize_t i = 0; i < n; i++)
+        {
+            if (buf[i] != expected(received[index] + i))
+            {
+                intact = 0;
+            }
+        }
+        received[index] += n;
+    }
+    uthread_close(fd);
+    return NULL;
+}
+
+int source[2];
+int destination[2];
+int pipeFds[2];
+
+void *producer(void *)
+{
+    char buf[CHUNK];
+    for (long sent = 0; sent < PROXIED; sent += CHUNK)
+    {
+        for (int i = 0; i < CHUNK; i++)
+        {
+            buf[i] = expected(sent + i);
+        }
+        for (int written = 0; written < CHUNK;)
+        {
+            written += uthread_write(source[0], buf + written, CHUNK - written);
+        }
+    }
+    uthread_close(source[0]);
+    return NULL;
+}
+
+// Socket to pipe to socket, without the bytes ever entering user space.
+void *proxy(void *)
+{
+    ssize_t n;
+    while ((n = uthread_splice(source[1], NULL, pipeFds[1], NULL, 65536, SPLICE_F_MOVE)) > 0)
+    {
+        while (n > 0)
+        {
+            n -= uthread_splice(pipeFds[0], NULL, destination[0], NULL, n, SPLICE_F_MOVE);
+        }
+    }
+    uthread_close(destination[0]);
+    return NULL;
+}
+
+void *consumer(void *)
+{
+    char buf[CHUNK];
+    long total = 0;
+    ssize_t n;
+    while ((n = uthread_read(destination[1], buf, CHUNK)) > 0)
+    {
+        for (ssize_t i = 0; i < n; i++)
+        {
+            if (buf[i] != expected(total + i))
+            {
+                intact = 0;
+            }
+        }
+        total += n;
+    }
+    return (void *) total;
+}
+
+int main()
+{
+    uthread_init(1000);
+    char path[] = "/tmp/uthreads_test14_XXXXXX";
+    file = mkstemp(path);
+    unlink(path);
+    static char block[65536];
+    for (long written = 0; written < FILE_SIZE; written += sizeof(block))
+    {
+        for (size_t i = 0; i < sizeof(block); i++)
+        {
+            block[i] = expected(written + i);
+        }
+        pwrite(file, block, sizeof(block), written);
+    }
+
+    int tids[2 * CLIENTS];
+    for (int i = 0; i < CLIENTS; i++)
+    {
+        socketpair(AF_UNIX, SOCK_STREAM, 0, connections[i]);
+        tids[2 * i] = uthread_spawn_routine(server, (void *) (intptr_t) i);
+        tids[2 * i + 1] = uthread_spawn_routine(client, (void *) (intptr_t) i);
+    }
+    for (int i = 0; i < 2 * CLIENTS; i++)
+    {
+        uthread_join(tids[i], NULL);
+    }
+    int full = 1;
+    for (int i = 0; i < CLIENTS; i++)
+    {
+        full = full && received[i] == FILE_SIZE;
+    }
+    printf("sendfile: %d clients each got %ld bytes, all intact: %s\n", CLIENTS, full ? (long) FILE_SIZE : -1L,
+           intact ? "yes" : "no");
+
+    socketpair(AF_UNIX, SOCK_STREAM, 0, source);
+    socketpair(AF_UNIX, SOCK_STREAM, 0, destination);
+    pipe(pipeFds);
+    uthread_spawn_routine(producer, NULL);
+    uthread_spawn_routine(proxy, NULL);
+    void *total;
+    uthread_join(uthread_spawn_routine(consumer, NULL), &total);
+    printf("splice: proxied %ld bytes, intact: %s\n", (long) total, intact ? "yes" : "no");
+    uthread_terminate(0);
+    return 0;
+}
@@ -0,0 +1,97 @@
+/*
+ * test15 - Offload pool: four threads each offload a 50 ms blocking call while a worker keeps computing. The calls
+ * run side by side on the helper threads, the worker is never stalled, and errno comes back from the helper.
+ *
+ * Output should be:
+ * offload: 4 blocking calls overlapped: yes
+ * offload: worker ran meanwhile: yes
+ * offload: fsync returned 0, failed open returned errno ENOENT: yes
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include "uthreads.h"
+
+#define CALLERS 4
+#define CALL_USECS 50000
+
+volatile int stop = 0;
+volatile long work = 0;
+
+long nowUsecs()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000000L + now.tv_nsec / 1000;
+}
+
+void *slowCall(void *)
+{
+    usleep(CALL_USECS);
+    return NULL;
+}
+
+void *caller(void *)
+{
+    uthread_offload(slowCall, NULL, NULL);
+    return NULL;
+}
+
+void worker()
+{
+    while (!stop)
+    {
+        work++;
+    }
+}
+
+void *syncFile(void *arg)
+{
+    return (void *) (intptr_t) fsync((int) (intptr_t) arg);
+}
+
+void *openMissing(void *)
+{
+    return (void *) (intptr_t) open("/nonexistent/uthreads_test15", O_RDONLY);
+}
+
+int main()
+{
+    uthread_init(1000);
+    uthread_spawn(worker);
+
+    long start = nowUsecs();
+    int tids[CALLERS];
+    for (int i = 0; i < CALLERS; i++)
+    {
+        tids[i] = uthread_spawn_routine(caller, NULL);
+    }
+    long workBefore = work;
+    for (int i = 0; i < CALLERS; i++)
+    {
+        uthread_join(tids[i], NULL);
+    }
+    long elapsed = nowUsecs() - start;
+    printf("offload: %d blocking calls overlapped: %s\n", CALLERS, elapsed < 2 * CALL_USECS ? "yes" : "no");
+    printf("offload: worker ran meanwhile: %s\n", work > workBefore ? "yes" : "no");
+
+    char path[] = "/tmp/uthreads_test15_XXXXXX";
+    int fd = mkstemp(path);
+    unlink(path);
+    write(fd, "data", 4);
+    void *synced;
+    uthread_offload(syncFile, (void *) (intptr_t) fd, &synced);
+    void *opened;
+    uthread_offload(openMissing, NULL, &opened);
+    int error = errno;
+    printf("offload: fsync returned %d, failed open returned errno ENOENT: %s\n", (int) (intptr_t) synced,
+           (intptr_t) opened == -1 && error == ENOENT ? "yes" : "no");
+    stop = 1;
+    uthread_terminate(0);
+    return 0;
+}
@@ -0,0 +1,132 @@
+/*
+ * test16 - Wall-clock sleeps and timeouts: a 20 ms sleep lasts 20 ms whether the other threads idle or compute,
+ * sleep_until wakes at its deadline, timed waits on a held mutex, an empty semaphore and an empty channel give up
+ * after their timeout, and a timed wait that is satisfied in time succeeds.
+ *
+ * Output should be:
+ * deadlines: idle sleep of 20 ms on time: yes
+ * deadlines: sleep of 20 ms beside a busy thread on time: yes
+ * deadlines: sleep_until on time: yes
+ * deadlines: mutex timed out 1, semaphore timed out 1, recv timed out 2: yes
+ * deadlines: zero timeouts only try: yes
+ * deadlines: recv with a sender in time returned 0 with 42: yes
+ */
+
+#include <stdio.h>
+#include <time.h>
+#include "uthreads.h"
+
+#define SLEEP_USECS 20000
+#define TIMEOUT_USECS 10000
+#define SLACK_USECS 8000
+
+volatile int stop = 0;
+volatile long work = 0;
+uthread_mutex_t mutex;
+uthread_chan_t *chan;
+
+long nowUsecs()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000000L + now.tv_nsec / 1000;
+}
+
+bool onTime(long elapsed, long expected)
+{
+    return elapsed >= expected && elapsed < expected + SLACK_USECS;
+}
+
+void busy()
+{
+    while (!stop)
+    {
+        work++;
+    }
+    uthread_terminate(uthread_get_tid());
+}
+
+void holder()
+{
+    uthread_mutex_lock(&mutex);
+    while (!stop)
+    {
+        uthread_sleep_usecs(1000);
+    }
+    uthread_mutex_unlock(&mutex);
+    uthread_terminate(uthread_get_tid());
+}
+
+void lateSender()
+{
+    uthread_sleep_usecs(TIMEOUT_USECS / 2);
+    int value = 42;
+    uthread_chan_send(chan, &value);
+    uthread_terminate(uthread_get_tid());
+}
+
+int main()
+{
+    uthread_init(1000);
+
+    long start = nowUsecs();
+    uthread_sleep_usecs(SLEEP_USECS);
+    printf("deadlines: idle sleep of 20 ms on time: %s\n", onTime(nowUsecs() - start, SLEEP_USECS) ? "yes" : "no");
+
+    int busyTid = uthread_spawn(busy);
+    start = nowUsecs();
+    uthread_sleep_usecs(SLEEP_USECS);
+    long elapsed = nowUsecs() - start;
+    stop = 1;
+    uthread_join(busyTid, NULL);
+    printf("deadlines: sleep of 20 ms beside a busy thread on time: %s\n",
+           onTime(elapsed, SLEEP_USECS) && work > 0 ? "yes" : "no");
+
+    struct timespec deadline;
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+    start = nowUsecs();
+    deadline.tv_nsec += SLEEP_USECS * 1000L;
+    if (deadline.tv_nsec >= 1000000000L)
+    {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000L;
+    }
+    uthread_sleep_until(&deadline);
+    printf("deadlines: sleep_until on time: %s\n", onTime(nowUsecs() - start, SLEEP_USECS) ? "yes" : "no");
+
+    stop = 0;
+    uthread_mutex_init(&mutex, UTHREAD_MUTEX_FAIR);
+    int holderTid = uthread_spawn(holder);
+    uthread_sleep_usecs(1000);
+    uthread_sem_t sem;
+    uthread_sem_init(&sem, 0);
+    chan = uthread_chan_create(sizeof(int), 0);
+    int value = 0;
+
+    start = nowUsecs();
+    int locked = uthread_mutex_lock_usecs(&mutex, TIMEOUT_USECS);
+    bool lockOnTime = onTime(nowUsecs() - start, TIMEOUT_USECS);
+    start = nowUsecs();
+    int waited = uthread_sem_wait_usecs(&sem, TIMEOUT_USECS);
+    bool semOnTime = onTime(nowUsecs() - start, TIMEOUT_USECS);
+    start = nowUsecs();
+    int received = uthread_chan_recv_usecs(chan, &value, TIMEOUT_USECS);
+    bool recvOnTime = onTime(nowUsecs() - start, TIMEOUT_USECS);
+    printf("deadlines: mutex timed out %d, semaphore timed out %d, recv timed out %d: %s\n", locked, waited, received,
+           lockOnTime && semOnTime && recvOnTime ? "yes" : "no");
+
+    bool tried = uthread_mutex_lock_usecs(&mutex, 0) == 1 && uthread_sem_wait_usecs(&sem, 0) == 1;
+    uthread_sem_post(&sem);
+    tried = tried && uthread_sem_wait_usecs(&sem, 0) == 0;
+    printf("deadlines: zero timeouts only try: %s\n", tried ? "yes" : "no");
+    stop = 1;
+    uthread_join(holderTid, NULL);
+
+    uthread_spawn(lateSender);
+    received = uthread_chan_recv_usecs(chan, &value, TIMEOUT_USECS);
+    printf("deadlines: recv with a sender in time returned %d with %d: %s\n", received, value,
+           received == 0 && value == 42 ? "yes" : "no");
+
+    uthread_terminate(0);
+    return 0;
+}
@@ -0,0 +1,95 @@
+/*
+ * test17 - Timer callbacks: a thousand periodic timers run side by side without a thread each, a one-shot timer
+ * wakes a thread waiting on a semaphore, a timer cancels itself from its callback, and a cancelled timer stops.
+ *
+ * Output should be:
+ * timers: 1000 timers of 5 ms each ran about 10 times in 50 ms: yes
+ * timers: one-shot timer woke the waiting thread on time: yes
+ * timers: self-cancelling timer ran 3 times: yes
+ * timers: cancelled timer stopped: yes
+ */
+
+#include <stdio.h>
+#include <time.h>
+#include "uthreads.h"
+
+#define TIMERS 1000
+#define PERIOD_USECS 5000
+#define RUN_USECS 50000
+
+int runs[TIMERS];
+int selfRuns = 0;
+int selfId;
+int stoppedRuns = 0;
+uthread_sem_t sem;
+
+long nowUsecs()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000000L + now.tv_nsec / 1000;
+}
+
+void count(void *arg)
+{
+    runs[(long) arg]++;
+}
+
+void post(void *)
+{
+    uthread_sem_post(&sem);
+}
+
+void cancelSelf(void *)
+{
+    if (++selfRuns == 3)
+    {
+        uthread_timer_cancel(selfId);
+    }
+}
+
+void countStopped(void *)
+{
+    stoppedRuns++;
+}
+
+int main()
+{
+    uthread_init(1000);
+
+    int ids[TIMERS];
+    for (long i = 0; i < TIMERS; i++)
+    {
+        ids[i] = uthread_timer_add(PERIOD_USECS, PERIOD_USECS, count, (void *) i);
+    }
+    uthread_sleep_usecs(RUN_USECS + PERIOD_USECS / 2);
+    bool regular = true;
+    for (int i = 0; i < TIMERS; i++)
+    {
+        uthread_timer_cancel(ids[i]);
+        regular = regular && runs[i] >= 9 && runs[i] <= 11;
+    }
+    printf("timers: %d timers of 5 ms each ran about 10 times in 50 ms: %s\n", TIMERS, regular ? "yes" : "no");
+
+    uthread_sem_init(&sem, 0);
+    long start = nowUsecs();
+    uthread_timer_add(10000, 0, post, NULL);
+    uthread_sem_wait(&sem);
+    long elapsed = nowUsecs() - start;
+    printf("timers: one-shot timer woke the waiting thread on time: %s\n",
+           elapsed >= 10000 && elapsed < 18000 ? "yes" : "no");
+
+    selfId = uthread_timer_add(1000, 1000, cancelSelf, NULL);
+    uthread_sleep_usecs(10000);
+    printf("timers: self-cancelling timer ran %d times: %s\n", selfRuns, selfRuns == 3 ? "yes" : "no");
+
+    int stopped = uthread_timer_add(1000, 1000, countStopped, NULL);
+    uthread_sleep_usecs(5500);
+    uthread_timer_cancel(stopped);
+    int before = stoppedRuns;
+    uthread_sleep_usecs(5000);
+    printf("timers: cancelled timer stopped: %s\n", before > 0 && stoppedRuns == before ? "yes" : "no");
+
+    uthread_terminate(0);
+    return 0;
+}
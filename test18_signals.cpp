@@ -0,0 +1,87 @@
+/*
+ * test18 - Signal waits: a thread waiting for SIGUSR1 gets it while another thread computes, threads waiting for
+ * different signals each get their own, a signal sent while nobody waits is kept for the next wait, and a thread
+ * spawned afterwards keeps the routed signal blocked.
+ *
+ * Output should be:
+ * signals: waiter got SIGUSR1 while a thread computed: yes
+ * signals: SIGUSR2 went to its waiter, SIGTERM to the other: yes
+ * signals: signal sent while nobody waited was kept: yes
+ * signals: new thread was not interrupted: yes
+ */
+
+#include <stdio.h>
+#include <signal.h>
+#include <unistd.h>
+#include "uthreads.h"
+
+volatile int stop = 0;
+volatile long work = 0;
+int got[MAX_THREAD_NUM];
+
+void busy()
+{
+    while (!stop)
+    {
+        work++;
+    }
+    uthread_terminate(uthread_get_tid());
+}
+
+void *waitFor(void *arg)
+{
+    sigset_t mask;
+    sigemptyset(&mask);
+    sigaddset(&mask, (int) (long) arg);
+    got[uthread_get_tid()] = uthread_signal_wait(&mask);
+    return NULL;
+}
+
+void *sendAfterAWhile(void *arg)
+{
+    long start = work;
+    while (work < start + 1000000)
+    {
+    }
+    kill(getpid(), (int) (long) arg);
+    return NULL;
+}
+
+int main()
+{
+    uthread_init(1000);
+
+    int busyTid = uthread_spawn(busy);
+    int waiter = uthread_spawn_routine(waitFor, (void *) SIGUSR1);
+    uthread_spawn_routine(sendAfterAWhile, (void *) SIGUSR1);
+    uthread_join(waiter, NULL);
+    printf("signals: waiter got SIGUSR1 while a thread computed: %s\n", got[waiter] == SIGUSR1 ? "yes" : "no");
+
+    int usr2 = uthread_spawn_routine(waitFor, (void *) SIGUSR2);
+    int term = uthread_spawn_routine(waitFor, (void *) SIGTERM);
+    uthread_sleep_usecs(1000);
+    kill(getpid(), SIGUSR2);
+    uthread_join(usr2, NULL);
+    kill(getpid(), SIGTERM);
+    uthread_join(term, NULL);
+    printf("signals: SIGUSR2 went to its waiter, SIGTERM to the other: %s\n",
+           got[usr2] == SIGUSR2 && got[term] == SIGTERM ? "yes" : "no");
+
+    kill(getpid(), SIGUSR1);
+    uthread_sleep_usecs(1000);
+    int late = uthread_spawn_routine(waitFor, (void *) SIGUSR1);
+    uthread_join(late, NULL);
+    printf("signals: signal sent while nobody waited was kept: %s\n", got[late] == SIGUSR1 ? "yes" : "no");
+
+    int sender = uthread_spawn_routine(sendAfterAWhile, (void *) SIGUSR1);
+    uthread_join(sender, NULL);
+    uthread_sleep_usecs(1000);
+    waiter = uthread_spawn_routine(waitFor, (void *) SIGUSR1);
+    uthread_join(waiter, NULL);
+    printf("signals: new thread was not interrupted: %s\n", got[waiter] == SIGUSR1 ? "yes" : "no");
+
+    stop = 1;
+    uthread_join(busyTid, NULL);
+    uthread_terminate(0);
+    return 0;
+}
@@ -0,0 +1,121 @@
+/*
+ * test19 - Embedding mode: the main thread runs its own epoll loop and drives the threads with uthread_run_ready,
+ * waiting on uthread_get_poll_fd for at most uthread_next_deadline. A sleeper wakes on time, a reader gets data
+ * the host writes into a pipe, and a thread that computes and yields gets its work done in slices of the budget.
+ *
+ * Output should be:
+ * embedded: no virtual timer armed: yes
+ * embedded: sleeper woke 3 times on time: yes
+ * embedded: reader got the host's message through the poll fd: yes
+ * embedded: yielding thread ran in budget slices: yes
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/time.h>
+#include "uthreads.h"
+
+#define SLEEP_USECS 5000
+#define BUDGET_USECS 1000
+
+int done = 0;
+bool sleptOnTime = true;
+int pipeFds[2];
+char message[16];
+int slices = 0;
+int lastSlice = -1;
+int hostRounds = 0;
+
+long nowUsecs()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000000L + now.tv_nsec / 1000;
+}
+
+void sleeper()
+{
+    for (int i = 0; i < 3; i++)
+    {
+        long start = nowUsecs();
+        uthread_sleep_usecs(SLEEP_USECS);
+        long elapsed = nowUsecs() - start;
+        sleptOnTime = sleptOnTime && elapsed >= SLEEP_USECS && elapsed < SLEEP_USECS + 4000;
+    }
+    done++;
+    uthread_terminate(uthread_get_tid());
+}
+
+void reader()
+{
+    uthread_read(pipeFds[0], message, sizeof(message) - 1);
+    done++;
+    uthread_terminate(uthread_get_tid());
+}
+
+void cruncher()
+{
+    for (int i = 0; i < 200; i++)
+    {
+        for (volatile int spin = 0; spin < 20000; spin++)
+        {
+        }
+        if (hostRounds != lastSlice)
+        {
+            lastSlice = hostRounds;
+            slices++;
+        }
+        uthread_yield();
+    }
+    done++;
+    uthread_terminate(uthread_get_tid());
+}
+
+int main()
+{
+    uthread_init_embedded(1000);
+    struct itimerval timer;
+    getitimer(ITIMER_VIRTUAL, &timer);
+    printf("embedded: no virtual timer armed: %s\n",
+           timer.it_value.tv_sec == 0 && timer.it_value.tv_usec == 0 ? "yes" : "no");
+
+    pipe(pipeFds);
+    uthread_spawn(sleeper);
+    uthread_spawn(reader);
+    uthread_spawn(cruncher);
+
+    int host = epoll_create1(0);
+    struct epoll_event event = {};
+    event.events = EPOLLIN;
+    epoll_ctl(host, EPOLL_CTL_ADD, uthread_get_poll_fd(), &event);
+
+    long start = nowUsecs();
+    bool written = false;
+    while (done < 3)
+    {
+        hostRounds++;
+        if (uthread_run_ready(BUDGET_USECS) > 0)
+        {
+            continue;
+        }
+        if (!written && nowUsecs() - start > 2 * SLEEP_USECS)
+        {
+            write(pipeFds[1], "hello", 5);
+            written = true;
+        }
+        long wait = uthread_next_deadline();
+        // Until the message is written, the host also wakes every millisecond for its own work.
+        int timeoutMs = wait < 0 || !written ? 1 : (int) ((wait + 999) / 1000);
+        epoll_wait(host, &event, 1, timeoutMs);
+    }
+
+    printf("embedded: sleeper woke 3 times on time: %s\n", sleptOnTime ? "yes" : "no");
+    printf("embedded: reader got the host's message through the poll fd: %s\n",
+           strcmp(message, "hello") == 0 ? "yes" : "no");
+    printf("embedded: yielding thread ran in budget slices: %s\n", slices > 1 && slices < 200 ? "yes" : "no");
+    uthread_terminate(0);
+    return 0;
+}
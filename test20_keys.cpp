@@ -0,0 +1,150 @@
+/*
+ * test20 - Thread-local keys: threads that keep switching each read back their own values, values stay with their
+ * thread across a handed-off system call while the others run on another kernel thread, destructors run for
+ * threads that return, exit or terminate themselves but not for a thread terminated by another, and deleting a key
+ * drops its values.
+ *
+ * Output should be:
+ * keys: each thread saw its own values: yes
+ * keys: values kept across a handed-off system call: yes
+ * keys: destructors ran for 3 threads that ended themselves, not for the one terminated: yes
+ * keys: a deleted key's values were dropped: yes
+ */
+
+#include <stdio.h>
+#include <unistd.h>
+#include "uthreads.h"
+
+#define THREADS 5
+
+uthread_key_t idKey;
+uthread_key_t squareKey;
+uthread_key_t ownedKey;
+bool ownValues = true;
+volatile int blockerDone = 0;
+bool keptAcrossHandoff = false;
+int destroyed = 0;
+int destroyedValues[MAX_THREAD_NUM];
+
+void destroy(void *value)
+{
+    destroyed++;
+    destroyedValues[(long) value]++;
+}
+
+void *checkOwn(void *arg)
+{
+    long id = (long) arg;
+    uthread_setspecific(idKey, (void *) id);
+    uthread_setspecific(squareKey, (void *) (id * id));
+    for (int i = 0; i < 200000; i++)
+    {
+        if ((long) uthread_getspecific(idKey) != id || (long) uthread_getspecific(squareKey) != id * id)
+        {
+            ownValues = false;
+        }
+    }
+    return NULL;
+}
+
+void *blocker(void *)
+{
+    uthread_setspecific(idKey, (void *) 7L);
+    uthread_enter_blocking();
+    usleep(100000);
+    uthread_exit_blocking();
+    keptAcrossHandoff = (long) uthread_getspecific(idKey) == 7;
+    blockerDone = 1;
+    return NULL;
+}
+
+void *spinner(void *)
+{
+    uthread_setspecific(idKey, (void *) 8L);
+    while (!blockerDone)
+    {
+        if ((long) uthread_getspecific(idKey) != 8)
+        {
+            ownValues = false;
+        }
+    }
+    return NULL;
+}
+
+void *returner(void *arg)
+{
+    uthread_setspecific(ownedKey, arg);
+    return NULL;
+}
+
+void *exiter(void *arg)
+{
+    uthread_setspecific(ownedKey, arg);
+    uthread_exit(NULL);
+    return NULL;
+}
+
+void terminator()
+{
+    uthread_setspecific(ownedKey, (void *) (long) uthread_get_tid());
+    uthread_terminate(uthread_get_tid());
+}
+
+void *waitToBeTerminated(void *arg)
+{
+    uthread_setspecific(ownedKey, arg);
+    while (true)
+    {
+    }
+    return NULL;
+}
+
+int main()
+{
+    uthread_init(1000);
+    uthread_key_create(&idKey, NULL);
+    uthread_key_create(&squareKey, NULL);
+    uthread_key_create(&ownedKey, destroy);
+
+    int tids[THREADS];
+    for (long i = 0; i < THREADS; i++)
+    {
+        tids[i] = uthread_spawn_routine(checkOwn, (void *) (i + 1));
+    }
+    for (int i = 0; i < THREADS; i++)
+    {
+        uthread_join(tids[i], NULL);
+    }
+    printf("keys: each thread saw its own values: %s\n", ownValues ? "yes" : "no");
+
+    uthread_set_syscall_handoff(1000);
+    int blockerTid = uthread_spawn_routine(blocker, NULL);
+    int spinnerTid = uthread_spawn_routine(spinner, NULL);
+    uthread_join(blockerTid, NULL);
+    uthread_join(spinnerTid, NULL);
+    uthread_set_syscall_handoff(0);
+    printf("keys: values kept across a handed-off system call: %s\n",
+           keptAcrossHandoff && ownValues ? "yes" : "no");
+
+    int returnerTid = uthread_spawn_routine(returner, (void *) 1L);
+    int exiterTid = uthread_spawn_routine(exiter, (void *) 2L);
+    int terminatorTid = uthread_spawn(terminator);
+    int victimTid = uthread_spawn_routine(waitToBeTerminated, (void *) 4L);
+    uthread_join(returnerTid, NULL);
+    uthread_join(exiterTid, NULL);
+    uthread_sleep_usecs(5000);
+    uthread_terminate(victimTid);
+    printf("keys: destructors ran for 3 threads that ended themselves, not for the one terminated: %s\n",
+           destroyed == 3 && destroyedValues[1] == 1 && destroyedValues[2] == 1 && destroyedValues[terminatorTid] == 1
+           && destroyedValues[4] == 0 ? "yes" : "no");
+
+    uthread_setspecific(squareKey, (void *) 9L);
+    uthread_key_delete(squareKey);
+    uthread_key_t fresh;
+    uthread_key_create(&fresh, NULL);
+    printf("keys: a deleted key's values were dropped: %s\n",
+           fresh == squareKey && uthread_getspecific(fresh) == NULL ? "yes" : "no");
+
+    uthread_terminate(0);
+    return 0;
+}
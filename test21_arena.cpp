@@ -0,0 +1,120 @@
+/*
+ * test21 - Per-thread arenas: threads that keep switching make thousands of small allocations each that are all
+ * aligned and never overlap, the chunks of ended threads are handed to the next threads, an allocation larger than
+ * a chunk works, and a std::vector grows through uthread_allocator.
+ *
+ * Output should be:
+ * arena: 4 threads made 10000 aligned allocations each without overlap: yes
+ * arena: chunks of ended threads were reused: yes
+ * arena: a 1 MB allocation worked: yes
+ * arena: vector with uthread_allocator summed 100000 ints: yes
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <vector>
+#include "uthreads.h"
+
+#define THREADS 4
+#define ALLOCS 10000
+#define LARGE (1024 * 1024)
+
+char *blocks[THREADS][ALLOCS];
+bool intact = true;
+char *reusedFirst;
+bool largeWorked = false;
+long vectorSum = 0;
+
+void *allocate(void *arg)
+{
+    long index = (long) arg;
+    for (int i = 0; i < ALLOCS; i++)
+    {
+        size_t size = 1 + i % 40;
+        blocks[index][i] = (char *) uthread_alloc(size);
+        memset(blocks[index][i], (int) (index * 64 + i % 64), size);
+    }
+    for (int i = 0; i < ALLOCS; i++)
+    {
+        size_t size = 1 + i % 40;
+        if ((uintptr_t) blocks[index][i] % 16 != 0)
+        {
+            intact = false;
+        }
+        for (size_t j = 0; j < size; j++)
+        {
+            if (blocks[index][i][j] != (char) (index * 64 + i % 64))
+            {
+                intact = false;
+            }
+        }
+    }
+    return NULL;
+}
+
+void *allocateOnce(void *)
+{
+    reusedFirst = (char *) uthread_alloc(8);
+    return NULL;
+}
+
+void *allocateLarge(void *)
+{
+    char *large = (char *) uthread_alloc(LARGE);
+    memset(large, 7, LARGE);
+    largeWorked = large[0] == 7 && large[LARGE - 1] == 7;
+    return NULL;
+}
+
+void *fillVector(void *)
+{
+    std::vector<int, uthread_allocator<int> > numbers;
+    for (int i = 1; i <= 100000; i++)
+    {
+        numbers.push_back(i);
+    }
+    for (size_t i = 0; i < numbers.size(); i++)
+    {
+        vectorSum += numbers[i];
+    }
+    return NULL;
+}
+
+int main()
+{
+    uthread_init(1000);
+
+    int tids[THREADS];
+    for (long i = 0; i < THREADS; i++)
+    {
+        tids[i] = uthread_spawn_routine(allocate, (void *) i);
+    }
+    for (int i = 0; i < THREADS; i++)
+    {
+        uthread_join(tids[i], NULL);
+    }
+    printf("arena: %d threads made %d aligned allocations each without overlap: %s\n", THREADS, ALLOCS,
+           intact ? "yes" : "no");
+
+    uthread_join(uthread_spawn_routine(allocateOnce, NULL), NULL);
+    bool reused = false;
+    for (int i = 0; i < THREADS; i++)
+    {
+        for (int j = 0; j < ALLOCS; j++)
+        {
+            reused = reused || blocks[i][j] == reusedFirst;
+        }
+    }
+    printf("arena: chunks of ended threads were reused: %s\n", reused ? "yes" : "no");
+
+    uthread_join(uthread_spawn_routine(allocateLarge, NULL), NULL);
+    printf("arena: a 1 MB allocation worked: %s\n", largeWorked ? "yes" : "no");
+
+    uthread_join(uthread_spawn_routine(fillVector, NULL), NULL);
+    printf("arena: vector with uthread_allocator summed 100000 ints: %s\n",
+           vectorSum == 100000L * 100001 / 2 ? "yes" : "no");
+
+    uthread_terminate(0);
+    return 0;
+}
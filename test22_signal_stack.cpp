@@ -0,0 +1,94 @@
+/*
+ * test22 - Preemption off the thread's stack: threads that are preempted over and over while computing in floating
+ * point get the same results as the main thread, and the part of their stack below what they use themselves is
+ * never written, because the timer's signal frame and the scheduler run on the carrier's signal stack.
+ *
+ * Output should be:
+ * signal stack: 8 threads computing in floating point were preempted and got exact results: yes
+ * signal stack: nothing was written below the threads' own frames: yes
+ */
+
+#include <stdio.h>
+#include "uthreads.h"
+
+#define THREADS 8
+#define PREEMPTIONS 10
+#define PAINT_FROM 1024   /* bytes below the thread's frame, past anything its own calls use */
+#define PAINT_SIZE 2048
+#define PAINT 0xA5
+
+volatile double step = 0.001;
+double expected;
+double results[THREADS];
+bool untouched[THREADS];
+
+double compute(int rounds)
+{
+    double sum = 0;
+    for (int i = 0; i < rounds; i++)
+    {
+        sum += step * i / (1.0 + step * (i % 7));
+    }
+    return sum;
+}
+
+void *work(void *arg)
+{
+    long index = (long) arg;
+    volatile char here;
+    volatile char *low = &here - PAINT_FROM - PAINT_SIZE;
+    for (int i = 0; i < PAINT_SIZE; i++)
+    {
+        low[i] = (char) PAINT;
+    }
+
+    int tid = uthread_get_tid();
+    int preemptions = 0;
+    int last = uthread_get_quantums(tid);
+    double result = 0;
+    while (preemptions < PREEMPTIONS)
+    {
+        result = compute(100000);
+        if (result != expected)
+        {
+            break;
+        }
+        int now = uthread_get_quantums(tid);
+        preemptions += now != last;
+        last = now;
+    }
+    results[index] = result;
+
+    untouched[index] = true;
+    for (int i = 0; i < PAINT_SIZE; i++)
+    {
+        untouched[index] = untouched[index] && low[i] == (char) PAINT;
+    }
+    return NULL;
+}
+
+int main()
+{
+    uthread_init(1000);
+    expected = compute(100000);
+
+    int tids[THREADS];
+    for (long i = 0; i < THREADS; i++)
+    {
+        tids[i] = uthread_spawn_routine(work, (void *) i);
+    }
+    bool exact = true;
+    bool clean = true;
+    for (int i = 0; i < THREADS; i++)
+    {
+        uthread_join(tids[i], NULL);
+        exact = exact && results[i] == expected;
+        clean = clean && untouched[i];
+    }
+    printf("signal stack: %d threads computing in floating point were preempted and got exact results: %s\n", THREADS,
+           exact ? "yes" : "no");
+    printf("signal stack: nothing was written below the threads' own frames: %s\n", clean ? "yes" : "no");
+
+    uthread_terminate(0);
+    return 0;
+}
@@ -0,0 +1,169 @@
+/*
+ * test23 - Shared-stack mode: many threads parked at different depths keep their frames while the others run on the
+ * same stack, and receive channel values and join results into variables on their copied-out stacks; threads
+ * preempted in the middle of their work keep their frames too; a thread may use far more than STACK_SIZE; and the
+ * mode cannot be switched while threads exist, nor combined with syscall handoff.
+ *
+ * Output should be:
+ * shared stack: 90 parked threads kept their frames and got their values: yes
+ * shared stack: a join result reached a joiner whose stack was copied out: yes
+ * shared stack: 4 preempted threads kept their frames: yes
+ * shared stack: a thread used 256 KB of stack: yes
+ * shared stack: mode switch and syscall handoff refused while in use: yes
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "uthreads.h"
+
+#define PARKED 90
+#define FRAME 256
+#define PREEMPTED 4
+#define PREEMPTIONS 10
+#define DEEP (256 * 1024)
+
+uthread_chan_t *values;
+bool parkedIntact = true;
+int received = 0;
+
+// Parks at a depth that differs from thread to thread, with a frame full of its own pattern at every level.
+bool parkAt(long index, int depth)
+{
+    char frame[FRAME];
+    memset(frame, (int) (index + depth), sizeof(frame));
+    bool intact;
+    if (depth > 0)
+    {
+        intact = parkAt(index, depth - 1);
+    }
+    else
+    {
+        long value = -1;
+        uthread_chan_recv(values, &value);
+        intact = value == index * 1000;
+        received++;
+    }
+    for (int i = 0; i < FRAME; i++)
+    {
+        intact = intact && frame[i] == (char) (index + depth);
+    }
+    return intact;
+}
+
+void *parker(void *arg)
+{
+    long index = (long) arg;
+    if (!parkAt(index, (int) (index % 8)))
+    {
+        parkedIntact = false;
+    }
+    return NULL;
+}
+
+void *answer(void *)
+{
+    uthread_sleep_usecs(2000);
+    return (void *) 42L;
+}
+
+void *joiner(void *arg)
+{
+    void *result = NULL;
+    uthread_join((int) (long) arg, &result);
+    return result;
+}
+
+void *compute(void *arg)
+{
+    long index = (long) arg;
+    volatile long frame[FRAME];
+    for (int i = 0; i < FRAME; i++)
+    {
+        frame[i] = index * i;
+    }
+    int tid = uthread_get_tid();
+    int preemptions = 0;
+    int last = uthread_get_quantums(tid);
+    bool intact = true;
+    while (preemptions < PREEMPTIONS)
+    {
+        for (int i = 0; i < FRAME; i++)
+        {
+            intact = intact && frame[i] == index * i;
+        }
+        int now = uthread_get_quantums(tid);
+        preemptions += now != last;
+        last = now;
+    }
+    return (void *) (long) intact;
+}
+
+void *deep(void *)
+{
+    char big[DEEP];
+    memset(big, 3, sizeof(big));
+    long sum = 0;
+    for (int i = 0; i < DEEP; i++)
+    {
+        sum += big[i];
+    }
+    uthread_yield();
+    return (void *) (long) (sum == 3L * DEEP);
+}
+
+int main()
+{
+    uthread_init(1000);
+    uthread_set_shared_stack(1);
+    values = uthread_chan_create(sizeof(long), 0);
+
+    int tids[PARKED];
+    for (long i = 0; i < PARKED; i++)
+    {
+        tids[i] = uthread_spawn_routine(parker, (void *) i);
+    }
+    uthread_sleep_usecs(5000);
+    for (long i = 0; i < PARKED; i++)
+    {
+        long value = i * 1000;
+        uthread_chan_send(values, &value);
+    }
+    for (int i = 0; i < PARKED; i++)
+    {
+        uthread_join(tids[i], NULL);
+    }
+    printf("shared stack: %d parked threads kept their frames and got their values: %s\n", PARKED,
+           parkedIntact && received == PARKED ? "yes" : "no");
+
+    int answerTid = uthread_spawn_routine(answer, NULL);
+    int joinerTid = uthread_spawn_routine(joiner, (void *) (long) answerTid);
+    void *joined = NULL;
+    uthread_join(joinerTid, &joined);
+    printf("shared stack: a join result reached a joiner whose stack was copied out: %s\n",
+           joined == (void *) 42L ? "yes" : "no");
+
+    for (long i = 0; i < PREEMPTED; i++)
+    {
+        tids[i] = uthread_spawn_routine(compute, (void *) (i + 1));
+    }
+    bool computedIntact = true;
+    for (int i = 0; i < PREEMPTED; i++)
+    {
+        void *intact = NULL;
+        uthread_join(tids[i], &intact);
+        computedIntact = computedIntact && intact != NULL;
+    }
+    printf("shared stack: %d preempted threads kept their frames: %s\n", PREEMPTED, computedIntact ? "yes" : "no");
+
+    void *deepWorked = NULL;
+    uthread_join(uthread_spawn_routine(deep, NULL), &deepWorked);
+    printf("shared stack: a thread used %d KB of stack: %s\n", DEEP / 1024, deepWorked != NULL ? "yes" : "no");
+
+    int blocker = uthread_spawn_routine(answer, NULL);
+    bool refused = uthread_set_shared_stack(0) == -1 && uthread_set_syscall_handoff(1000) == -1;
+    uthread_join(blocker, NULL);
+    printf("shared stack: mode switch and syscall handoff refused while in use: %s\n", refused ? "yes" : "no");
+
+    uthread_terminate(0);
+    return 0;
+}
@@ -0,0 +1,112 @@
+/*
+ * test24 - Cache-affine wakeups: a thread resumed while still cache-warm runs before the thread already READY,
+ * two threads resuming each other are put back at the tail once the streak cap is reached, so the READY filler
+ * still gets its turns, and the placement counters count every wakeup on the side it was queued.
+ *
+ * Each letter is one turn: T the resumed thread, P and Q the pair, f the filler. The fourth affine dispatch in a row
+ * is the last, so P's next wakeup of Q goes to the tail, behind the filler; the other nine wakeups go to the head.
+ *
+ * Output should be:
+ * window: TfTf, resumed thread ran next: yes
+ * cap: fPQPQPfQPQPf
+ * counters: 9 affine, 1 tail
+ */
+
+#include <stdio.h>
+#include "uthreads.h"
+
+#define WINDOW 10
+#define PINGS 5
+#define CAP_TURNS 12
+
+char trace[64];
+int traceLength = 0;
+int stop = 0;
+int pings = 0;
+int p, q;
+
+void mark(char c)
+{
+    if (traceLength < (int) sizeof(trace) - 1)
+    {
+        trace[traceLength++] = c;
+        trace[traceLength] = '\0';
+    }
+}
+
+void filler()
+{
+    while (!stop)
+    {
+        mark('f');
+        uthread_yield();
+    }
+    uthread_terminate(uthread_get_tid());
+}
+
+void resumed()
+{
+    mark('T');
+    uthread_block(uthread_get_tid());
+    mark('T');
+    uthread_terminate(uthread_get_tid());
+}
+
+/* P and Q take turns: each wakes the other, then blocks itself. */
+void pinger()
+{
+    while (pings < PINGS)
+    {
+        mark('P');
+        pings++;
+        uthread_resume(q);
+        uthread_block(p);
+    }
+    uthread_terminate(p);
+}
+
+void ponger()
+{
+    uthread_block(q);
+    while (pings < PINGS)
+    {
+        mark('Q');
+        uthread_resume(p);
+        uthread_block(q);
+    }
+    uthread_terminate(q);
+}
+
+int main()
+{
+    uthread_init(1000000);
+    uthread_set_wake_affine(WINDOW);
+    int affineBefore, tailBefore;
+    uthread_get_wake_stats(&affineBefore, &tailBefore);
+
+    int t = uthread_spawn(resumed);
+    uthread_spawn(filler);
+    uthread_yield();
+    // The filler is READY ahead of main; the resumed thread ran two quantums ago and goes in front of it.
+    uthread_resume(t);
+    uthread_yield();
+    printf("window: %s, resumed thread ran next: %s\n", trace, trace[2] == 'T' ? "yes" : "no");
+
+    traceLength = 0;
+    trace[0] = '\0';
+    q = uthread_spawn(ponger);
+    p = uthread_spawn(pinger);
+    while (traceLength < CAP_TURNS)
+    {
+        uthread_yield();
+    }
+    trace[CAP_TURNS] = '\0';
+    printf("cap: %s\n", trace);
+
+    int affine, tail;
+    uthread_get_wake_stats(&affine, &tail);
+    printf("counters: %d affine, %d tail\n", affine - affineBefore, tail - tailBefore);
+    stop = 1;
+    uthread_terminate(0);
+    return 0;
+}
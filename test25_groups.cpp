@@ -0,0 +1,97 @@
+/*
+ * test25 - Gang scheduling groups: two groups of two threads with 3 and 1 CPU shares. Each round of a group runs
+ * both its members back to back, the group with three shares gets three times the quantums of the other, and the
+ * group calls reject invalid shares, groups and threads.
+ *
+ * Each letter in the trace is one quantum: a and A the members of the 3-share group, b and B of the 1-share group.
+ *
+ * Output should be:
+ * errors rejected: 7 of 7
+ * trace: aAbBaAaAaAbBaAaAaAbBaAaA
+ * gang: both members ran back to back in every round: yes
+ * shares: 60 quantums to 20, ratio 3
+ * destroyed group members still run: yes
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include "uthreads.h"
+
+#define TURNS 80
+#define TRACED 24
+
+char trace[TURNS + 1];
+int turns = 0;
+int ran[4];
+const char names[] = "aAbB";
+
+int groupOf(char name)
+{
+    return name == 'a' || name == 'A' ? 0 : 1;
+}
+
+void *member(void *arg)
+{
+    int index = (int) (intptr_t) arg;
+    while (turns < TURNS)
+    {
+        trace[turns++] = names[index];
+        ran[index]++;
+        uthread_yield();
+    }
+    return NULL;
+}
+
+int main()
+{
+    uthread_init(1000000);
+
+    int heavy = uthread_group_create(3);
+    int light = uthread_group_create(1);
+    int rejected = 0;
+    rejected += uthread_group_create(0) == -1;
+    rejected += uthread_group_create(UTHREAD_MAX_GROUP_SHARES + 1) == -1;
+    rejected += uthread_group_join(-1, 0) == -1;
+    rejected += uthread_group_join(heavy, MAX_THREAD_NUM) == -1;
+    rejected += uthread_group_join(heavy, 42) == -1;
+    rejected += uthread_group_leave(42) == -1;
+    rejected += uthread_group_destroy(light + 1) == -1;
+    printf("errors rejected: %d of 7\n", rejected);
+
+    int tids[4];
+    for (int i = 0; i < 4; i++)
+    {
+        tids[i] = uthread_spawn_routine(member, (void *) (intptr_t) i);
+        uthread_group_join(i < 2 ? heavy : light, tids[i]);
+    }
+    for (int i = 0; i < 4; i++)
+    {
+        uthread_join(tids[i], NULL);
+    }
+    printf("trace: %.*s\n", TRACED, trace);
+
+    // Rounds take two quantums each, one per member, so the trace splits into pairs from the same group.
+    int paired = 1;
+    for (int i = 0; i + 1 < TURNS; i += 2)
+    {
+        if (trace[i] == trace[i + 1] || groupOf(trace[i]) != groupOf(trace[i + 1]))
+        {
+            paired = 0;
+        }
+    }
+    printf("gang: both members ran back to back in every round: %s\n", paired ? "yes" : "no");
+    int heavyRan = ran[0] + ran[1];
+    int lightRan = ran[2] + ran[3];
+    printf("shares: %d quantums to %d, ratio %d\n", heavyRan, lightRan, lightRan ? heavyRan / lightRan : 0);
+
+    // Destroying a group leaves its members running outside any group.
+    turns = 0;
+    tids[0] = uthread_spawn_routine(member, (void *) (intptr_t) 0);
+    uthread_group_join(heavy, tids[0]);
+    uthread_group_destroy(heavy);
+    uthread_join(tids[0], NULL);
+    printf("destroyed group members still run: %s\n", turns == TURNS ? "yes" : "no");
+    uthread_group_destroy(light);
+    uthread_terminate(0);
+    return 0;
+}
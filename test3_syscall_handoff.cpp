@@ -0,0 +1,53 @@
+/*
+ * test3 - Syscall handoff: a thread blocked in the kernel inside uthread_enter_blocking/uthread_exit_blocking must
+ * not stall the other threads.
+ *
+ * Output should be:
+ * blocker: in the kernel
+ * blocker: back, worker made progress meanwhile: yes
+ * main: done
+ */
+
+#include <stdio.h>
+#include <unistd.h>
+#include "uthreads.h"
+
+volatile int done = 0;
+volatile long progress = 0;
+
+void blocker()
+{
+    printf("blocker: in the kernel\n");
+    fflush(stdout);
+    long before = progress;
+    uthread_enter_blocking();
+    usleep(300000);
+    uthread_exit_blocking();
+    printf("blocker: back, worker made progress meanwhile: %s\n", progress > before ? "yes" : "no");
+    fflush(stdout);
+    done = 1;
+    uthread_terminate(uthread_get_tid());
+}
+
+void worker()
+{
+    while (!done)
+    {
+        progress++;
+    }
+    uthread_terminate(uthread_get_tid());
+}
+
+int main()
+{
+    uthread_init(1000);
+    uthread_set_syscall_handoff(1000);
+    uthread_spawn(blocker);
+    uthread_spawn(worker);
+    while (!done)
+    {
+    }
+    printf("main: done\n");
+    uthread_terminate(0);
+    return 0;
+}
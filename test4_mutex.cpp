@@ -0,0 +1,68 @@
+/*
+ * test4 - Blocking mutex: threads preempted inside the critical section must not let anyone else in, in both
+ * fair and barging mode.
+ *
+ * Output should be:
+ * fair: counter=20000 max inside=1
+ * barging: counter=20000 max inside=1
+ */
+
+#include <stdio.h>
+#include "uthreads.h"
+
+#define WORKERS 4
+#define ROUNDS 5000
+
+uthread_mutex_t mutex;
+volatile long counter = 0;
+volatile int inside = 0;
+volatile int maxInside = 0;
+volatile int finished = 0;
+
+void worker()
+{
+    for (int i = 0; i < ROUNDS; i++)
+    {
+        uthread_mutex_lock(&mutex);
+        inside++;
+        if (inside > maxInside)
+        {
+            maxInside = inside;
+        }
+        long value = counter;
+        for (volatile int spin = 0; spin < 200; spin++)
+        {
+        }
+        counter = value + 1;
+        inside--;
+        uthread_mutex_unlock(&mutex);
+    }
+    finished++;
+    uthread_terminate(uthread_get_tid());
+}
+
+void run(const char *name, int kind)
+{
+    uthread_mutex_init(&mutex, kind);
+    counter = 0;
+    maxInside = 0;
+    finished = 0;
+    for (int i = 0; i < WORKERS; i++)
+    {
+        uthread_spawn(worker);
+    }
+    while (finished < WORKERS)
+    {
+    }
+    printf("%s: counter=%ld max inside=%d\n", name, counter, maxInside);
+    uthread_mutex_destroy(&mutex);
+}
+
+int main()
+{
+    uthread_init(100);
+    run("fair", UTHREAD_MUTEX_FAIR);
+    run("barging", UTHREAD_MUTEX_BARGING);
+    uthread_terminate(0);
+    return 0;
+}
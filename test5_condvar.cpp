@@ -0,0 +1,103 @@
+/*
+ * test5 - Condition variables: a bounded producer/consumer queue that never polls, plus a timed wait that expires.
+ *
+ * Output should be:
+ * consumed 2000 items, sum=2001000
+ * timed wait expired: yes
+ */
+
+#include <stdio.h>
+#include "uthreads.h"
+
+#define ITEMS 2000
+#define CAPACITY 8
+#define CONSUMERS 3
+
+uthread_mutex_t mutex = UTHREAD_MUTEX_INITIALIZER;
+uthread_cond_t changed = UTHREAD_COND_INITIALIZER;
+uthread_cond_t done = UTHREAD_COND_INITIALIZER;
+int queue[CAPACITY];
+int head = 0;
+int tail = 0;
+int consumed = 0;
+long sum = 0;
+int finished = 0;
+
+void finish()
+{
+    finished++;
+    uthread_cond_signal(&done);
+    uthread_mutex_unlock(&mutex);
+    uthread_terminate(uthread_get_tid());
+}
+
+void producer()
+{
+    for (int i = 1; i <= ITEMS; i++)
+    {
+        uthread_mutex_lock(&mutex);
+        while (tail - head == CAPACITY)
+        {
+            uthread_cond_wait(&changed, &mutex);
+        }
+        queue[tail++ % CAPACITY] = i;
+        uthread_cond_broadcast(&changed);
+        uthread_mutex_unlock(&mutex);
+    }
+    uthread_mutex_lock(&mutex);
+    finish();
+}
+
+void consumer()
+{
+    uthread_mutex_lock(&mutex);
+    while (consumed < ITEMS)
+    {
+        if (tail == head)
+        {
+            uthread_cond_wait(&changed, &mutex);
+            continue;
+        }
+        sum += queue[head++ % CAPACITY];
+        consumed++;
+        uthread_cond_broadcast(&changed);
+    }
+    uthread_cond_broadcast(&changed);
+    finish();
+}
+
+volatile int spinning = 1;
+
+void spinner()
+{
+    while (spinning)
+    {
+    }
+    uthread_terminate(uthread_get_tid());
+}
+
+int main()
+{
+    uthread_init(100);
+    uthread_spawn(producer);
+    for (int i = 0; i < CONSUMERS; i++)
+    {
+        uthread_spawn(consumer);
+    }
+
+    uthread_mutex_lock(&mutex);
+    while (finished < CONSUMERS + 1)
+    {
+        uthread_cond_wait(&done, &mutex);
+    }
+    printf("consumed %d items, sum=%ld\n", consumed, sum);
+
+    // Nobody signals this one; a spinning thread keeps the quantums going while the timeout runs out.
+    uthread_spawn(spinner);
+    int result = uthread_cond_timedwait(&changed, &mutex, 3);
+    printf("timed wait expired: %s\n", result == 1 ? "yes" : "no");
+    spinning = 0;
+    uthread_mutex_unlock(&mutex);
+    uthread_terminate(0);
+    return 0;
+}
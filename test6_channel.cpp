@@ -0,0 +1,82 @@
+/*
+ * test6 - Channels: an unbuffered ping-pong that must cost two context switches per round trip, and a buffered
+ * pipeline of strings that is closed and drained.
+ *
+ * Output should be:
+ * ping-pong: 1000 round trips, 2 switches each
+ * pipeline: received 500 strings, total length 3890, closed: yes
+ */
+
+#include <stdio.h>
+#include <string>
+#include "uthreads.h"
+#include "channel.h"
+
+#define ROUND_TRIPS 1000
+#define STRINGS 500
+
+uthread_chan_t *ping;
+uthread_chan_t *pong;
+Channel<std::string> *lines;
+
+void ponger()
+{
+    int value;
+    while (uthread_chan_recv(ping, &value) == 0)
+    {
+        value++;
+        uthread_chan_send(pong, &value);
+    }
+    uthread_terminate(uthread_get_tid());
+}
+
+void producer()
+{
+    for (int i = 0; i < STRINGS; i++)
+    {
+        lines->send("line " + std::to_string(i));
+    }
+    lines->close();
+    uthread_terminate(uthread_get_tid());
+}
+
+int main()
+{
+    // A quantum long enough that nothing is preempted, so every switch is caused by the channels.
+    uthread_init(1000000);
+    ping = uthread_chan_create(sizeof(int), 0);
+    pong = uthread_chan_create(sizeof(int), 0);
+    uthread_spawn(ponger);
+
+    int value = 0;
+    uthread_chan_send(ping, &value);
+    uthread_chan_recv(pong, &value);
+    int before = uthread_get_total_quantums();
+    for (int i = 0; i < ROUND_TRIPS; i++)
+    {
+        uthread_chan_send(ping, &value);
+        uthread_chan_recv(pong, &value);
+    }
+    int switches = uthread_get_total_quantums() - before;
+    printf("ping-pong: %d round trips, %d switches each\n", value - 1, switches / ROUND_TRIPS);
+    uthread_chan_close(ping);
+
+    Channel<std::string> channel(16);
+    lines = &channel;
+    uthread_spawn(producer);
+    std::string line;
+    int count = 0;
+    size_t length = 0;
+    while (channel.recv(line))
+    {
+        count++;
+        length += line.size();
+    }
+    printf("pipeline: received %d strings, total length %zu, closed: %s\n", count, length,
+           channel.recv(line) ? "no" : "yes");
+
+    uthread_chan_destroy(ping);
+    uthread_chan_destroy(pong);
+    uthread_terminate(0);
+    return 0;
+}
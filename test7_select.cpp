@@ -0,0 +1,80 @@
+/*
+ * test7 - Select: one aggregator thread fans in three producers through a single uthread_select loop, each value
+ * arriving exactly once, then a select with no ready channel times out.
+ *
+ * Output should be:
+ * fan-in: 300 values, sum=15150, closed channels=3
+ * timeout fired: yes
+ */
+
+#include <stdio.h>
+#include "uthreads.h"
+
+#define PRODUCERS 3
+#define VALUES 100
+
+uthread_chan_t *inputs[PRODUCERS];
+int nextProducer = 0;
+
+void producer()
+{
+    uthread_chan_t *out = inputs[nextProducer++];
+    for (int i = 1; i <= VALUES; i++)
+    {
+        uthread_chan_send(out, &i);
+    }
+    uthread_chan_close(out);
+    uthread_terminate(uthread_get_tid());
+}
+
+volatile int spinning = 1;
+
+void spinner()
+{
+    while (spinning)
+    {
+    }
+    uthread_terminate(uthread_get_tid());
+}
+
+int main()
+{
+    uthread_init(100);
+    int received[PRODUCERS];
+    uthread_select_case_t cases[PRODUCERS];
+    for (int i = 0; i < PRODUCERS; i++)
+    {
+        inputs[i] = uthread_chan_create(sizeof(int), i);
+        cases[i].chan = inputs[i];
+        cases[i].op = UTHREAD_SELECT_RECV;
+        cases[i].elem = &received[i];
+        uthread_spawn(producer);
+    }
+
+    int count = 0;
+    long sum = 0;
+    int open = PRODUCERS;
+    while (open > 0)
+    {
+        int fired = uthread_select(cases, PRODUCERS, 0);
+        if (cases[fired].closed)
+        {
+            // A null channel is never ready again.
+            cases[fired].chan = NULL;
+            open--;
+            continue;
+        }
+        count++;
+        sum += received[fired];
+    }
+    printf("fan-in: %d values, sum=%ld, closed channels=%d\n", count, sum, PRODUCERS - open);
+
+    uthread_chan_t *idle = uthread_chan_create(sizeof(int), 0);
+    uthread_select_case_t wait = {idle, UTHREAD_SELECT_RECV, &received[0], 0};
+    uthread_spawn(spinner);
+    int fired = uthread_select(&wait, 1, 3);
+    printf("timeout fired: %s\n", fired == 1 ? "yes" : "no");
+    spinning = 0;
+    uthread_terminate(0);
+    return 0;
+}
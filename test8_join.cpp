@@ -0,0 +1,101 @@
+/*
+ * test8 - Join and wait groups: main collects the return values of joinable workers, one of which exits before it
+ * is joined, and a wait group releases all its waiters at once, with nobody spinning.
+ *
+ * Output should be:
+ * joined: 0 1 4 9 16, sum of squares=30
+ * early exit collected: 42, tid reused: no
+ * plain threads joined after 6 steps
+ * wait group: 4 waiters released, 4 workers done
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include "uthreads.h"
+
+#define WORKERS 5
+#define WAITERS 4
+
+void *square(void *arg)
+{
+    intptr_t n = (intptr_t) arg;
+    for (volatile int spin = 0; spin < 100000; spin++)
+    {
+    }
+    return (void *) (n * n);
+}
+
+void *early(void *arg)
+{
+    uthread_exit(arg);
+    return NULL;
+}
+
+int steps = 0;
+
+void plain()
+{
+    for (int i = 0; i < 3; i++)
+    {
+        steps++;
+    }
+    // Returning ends the thread like uthread_terminate.
+}
+
+uthread_waitgroup_t done = UTHREAD_WAITGROUP_INITIALIZER;
+uthread_waitgroup_t start = UTHREAD_WAITGROUP_INITIALIZER;
+int released = 0;
+int finished = 0;
+
+void *gated(void *arg)
+{
+    (void) arg;
+    uthread_waitgroup_wait(&start);
+    released++;
+    finished++;
+    uthread_waitgroup_done(&done);
+    return NULL;
+}
+
+int main()
+{
+    uthread_init(100);
+    int tids[WORKERS];
+    for (intptr_t i = 0; i < WORKERS; i++)
+    {
+        tids[i] = uthread_spawn_routine(square, (void *) i);
+    }
+    printf("joined:");
+    long sum = 0;
+    for (int i = 0; i < WORKERS; i++)
+    {
+        void *value;
+        uthread_join(tids[i], &value);
+        printf(" %ld", (long) (intptr_t) value);
+        sum += (long) (intptr_t) value;
+    }
+    printf(", sum of squares=%ld\n", sum);
+
+    int early_tid = uthread_spawn_routine(early, (void *) 42);
+    // Let it exit before anyone joins it: its tid stays reserved until collected.
+    int plain_tid = uthread_spawn(plain);
+    uthread_join(plain_tid, NULL);
+    int other = uthread_spawn(plain);
+    void *value;
+    uthread_join(early_tid, &value);
+    printf("early exit collected: %ld, tid reused: %s\n", (long) (intptr_t) value, other == early_tid ? "yes" : "no");
+    uthread_join(other, NULL);
+    printf("plain threads joined after %d steps\n", steps);
+
+    uthread_waitgroup_init(&start, 1);
+    uthread_waitgroup_init(&done, WAITERS);
+    for (int i = 0; i < WAITERS; i++)
+    {
+        uthread_spawn_routine(gated, NULL);
+    }
+    uthread_waitgroup_add(&start, -1);
+    uthread_waitgroup_wait(&done);
+    printf("wait group: %d waiters released, %d workers done\n", released, finished);
+    uthread_terminate(0);
+    return 0;
+}
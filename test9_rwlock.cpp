@@ -0,0 +1,116 @@
+/*
+ * test9 - Reader-writer lock: readers share a table that a writer rewrites in place, no reader ever sees a half
+ * written table, and readers queued behind a writer are all released together when it unlocks.
+ *
+ * Output should be:
+ * reads: 4000, torn reads: 0, shared reads seen: yes
+ * writes: 200
+ * readers released together: 3
+ */
+
+#include <stdio.h>
+#include "uthreads.h"
+
+#define READERS 4
+#define READS 1000
+#define WRITES 200
+#define ENTRIES 16
+
+uthread_rwlock_t lock = UTHREAD_RWLOCK_INITIALIZER;
+int table[ENTRIES];
+long reads = 0;
+int torn = 0;
+int writes = 0;
+int readingNow = 0;
+int maxReading = 0;
+uthread_waitgroup_t done = UTHREAD_WAITGROUP_INITIALIZER;
+
+void reader()
+{
+    for (int i = 0; i < READS; i++)
+    {
+        uthread_rwlock_rdlock(&lock);
+        readingNow++;
+        if (readingNow > maxReading)
+        {
+            maxReading = readingNow;
+        }
+        for (int e = 1; e < ENTRIES; e++)
+        {
+            if (table[e] != table[0])
+            {
+                torn++;
+            }
+        }
+        for (volatile int spin = 0; spin < 20000; spin++)
+        {
+        }
+        readingNow--;
+        reads++;
+        uthread_rwlock_unlock(&lock);
+    }
+    uthread_waitgroup_done(&done);
+}
+
+void writer()
+{
+    for (int i = 0; i < WRITES; i++)
+    {
+        uthread_rwlock_wrlock(&lock);
+        for (int e = 0; e < ENTRIES; e++)
+        {
+            table[e]++;
+            for (volatile int spin = 0; spin < 100; spin++)
+            {
+            }
+        }
+        writes++;
+        uthread_rwlock_unlock(&lock);
+        for (volatile int spin = 0; spin < 20000; spin++)
+        {
+        }
+    }
+    uthread_waitgroup_done(&done);
+}
+
+int released = 0;
+
+void queuedReader()
+{
+    uthread_rwlock_rdlock(&lock);
+    released++;
+    uthread_rwlock_unlock(&lock);
+    uthread_waitgroup_done(&done);
+}
+
+int main()
+{
+    uthread_init(100);
+    uthread_waitgroup_init(&done, READERS + 1);
+    for (int i = 0; i < READERS; i++)
+    {
+        uthread_spawn(reader);
+    }
+    uthread_spawn(writer);
+    uthread_waitgroup_wait(&done);
+    printf("reads: %ld, torn reads: %d, shared reads seen: %s\n", reads, torn, maxReading > 1 ? "yes" : "no");
+    printf("writes: %d\n", writes);
+
+    // Hold the lock for writing while three readers queue up, then release them all with one unlock.
+    uthread_waitgroup_init(&done, 3);
+    uthread_rwlock_wrlock(&lock);
+    for (int i = 0; i < 3; i++)
+    {
+        uthread_spawn(queuedReader);
+    }
+    // Once main has been preempted and run again, all three have run and blocked.
+    int quantums = uthread_get_quantums(0);
+    while (uthread_get_quantums(0) == quantums)
+    {
+    }
+    uthread_rwlock_unlock(&lock);
+    uthread_waitgroup_wait(&done);
+    printf("readers released together: %d\n", released);
+    uthread_terminate(0);
+    return 0;
+}
@@ -1,5 +1,9 @@
 #include "thread.h"
+#include "signals.h"
 #include <cstdlib>
+#include <new>
+#include <cstring>
+#include <cstdint>
 #include <iostream>
 
 // Translate address exactly like in demo_jmp.c
@@ -21,21 +25,42 @@ address_t Thread::translate_address(address_t addr) {
 #endif
 }
 
-Thread::Thread(int id, void (*entryPoint)()) :
-    id(id), state(READY), quantumCount(0), stack(nullptr), didUserBlock(false)
-{
-    if (id == 0) {
-        // Main thread: no need to set up stack or context manually
-        return;
-    }
+// Where the kernel describes the XSAVE area of a signal frame: struct _fpx_sw_bytes in the FXSAVE area's reserved
+// bytes, valid when it starts with FP_XSTATE_MAGIC1.
+#define FPX_SW_BYTES_OFFSET 464
+#define FP_XSTATE_MAGIC1 0x46505853U
+#define FXSAVE_SIZE 512
 
-    stack = new(std::nothrow) char[STACK_SIZE];
-    if (stack == nullptr) {
-        std::cerr << "system error: cannot allocate stack\n";
-        exit(1);
-    }
+// Bytes below the stack pointer that code interrupted by a signal may still be using.
+#define RED_ZONE 128
+
+Thread* Thread::slab = nullptr;
+char* Thread::stacks = nullptr;
+sigjmp_buf Thread::templateEnv;
+address_t Thread::templatePc = 0;
+char* Thread::frames = nullptr;
+size_t Thread::frameSize = 0;
+size_t Thread::fpstateSize = 0;
+bool Thread::sharedMode = false;
+char* Thread::sharedStack = nullptr;
+Thread* Thread::sharedOwner = nullptr;
+
+Thread::Thread(int id) :
+    id(id), state(READY), stack(nullptr), quantumCount(0), didUserBlock(false),
+    lastRunQuantum(0), wokenAffine(false), handedOff(false), killPending(false),
+    groupId(-1), gangRound(0), parked(false), waiters(nullptr), entryPoint(nullptr), routine(nullptr),
+    arg(nullptr), retval(nullptr), joiners{nullptr, nullptr}, basePriority(0), priority(0),
+    piBlockedOn(nullptr), piHeld(nullptr), specific{}, arena{}, started(id == 0),
+    preempted(false), stackLow(nullptr), stackCopy(nullptr), stackCopySize(0), stackCopyCapacity(0)
+{
+    // The main thread runs on the process stack; the others get their stack and context in start, once first
+    // scheduled, so a thread terminated before it ever ran costs nothing more than this.
+}
 
-    char* sp_ptr = stack + STACK_SIZE - sizeof(address_t);
+// Builds a context that starts entryPoint at the top of the given stack with only the signals routed to
+// uthread_signal_wait blocked.
+void Thread::setupContext(sigjmp_buf& env, char* stack, size_t size, void (*entryPoint)()) {
+    char* sp_ptr = stack + size - sizeof(address_t);
     address_t sp = (address_t)(sp_ptr);
     address_t pc = (address_t)(entryPoint);
 
@@ -43,14 +68,182 @@ Thread::Thread(int id, void (*entryPoint)()) :
     if (sigsetjmp(env, 1) == 0) {
         env->__jmpbuf[JB_SP] = translate_address(sp);
         env->__jmpbuf[JB_PC] = translate_address(pc);
-        sigemptyset(&env->__saved_mask);
+        Signals::initMask(&env->__saved_mask);
+    }
+}
+
+// Reserves a Thread, a stack and a PreemptFrame with fpstateBytes of XSAVE area for every possible tid at once, so
+// spawning and terminating never allocate a TCB or a stack, and captures the context every thread starts from,
+// entering at entryPoint, which runs the entry set by setEntry.
+void Thread::initPool(void (*entryPoint)(), size_t fpstateBytes) {
+    if (slab != nullptr) {
+        return;
+    }
+    sigsetjmp(templateEnv, 1);
+    templatePc = translate_address((address_t)(entryPoint));
+    slab = static_cast<Thread*>(operator new(sizeof(Thread) * MAX_THREAD_NUM, std::nothrow));
+    stacks = new(std::nothrow) char[static_cast<size_t>(STACK_SIZE) * MAX_THREAD_NUM];
+    if (fpstateBytes > 0) {
+        fpstateSize = fpstateBytes;
+        frameSize = (offsetof(PreemptFrame, fpstate) + fpstateBytes + 63) & ~static_cast<size_t>(63);
+        void* memory = nullptr;
+        frames = posix_memalign(&memory, 64, frameSize * MAX_THREAD_NUM) == 0 ? static_cast<char*>(memory) : nullptr;
+    }
+    if (slab == nullptr || stacks == nullptr || (fpstateBytes > 0 && frames == nullptr)) {
+        std::cerr << "system error: cannot allocate thread pool\n";
+        exit(1);
+    }
+}
+
+// Builds the thread in place in the slot of its tid, which no other live thread holds. Only the TCB and its stack
+// come from the slab; queueing the thread may still allocate in the scheduler's containers.
+Thread* Thread::create(int id) {
+    return new(&slab[id]) Thread(id);
+}
+
+void Thread::destroy(Thread* thread) {
+    if (sharedOwner == thread) {
+        sharedOwner = nullptr;
+    }
+    free(thread->stackCopy);
+    thread->~Thread();
+}
+
+// Bytes of XSAVE area in a signal frame, as the kernel records in the software-reserved bytes of its FXSAVE
+// header, or just the legacy FXSAVE area without XSAVE.
+size_t Thread::fpstateSizeOf(const ucontext_t* context) {
+#ifdef __x86_64__
+    const char* fpstate = reinterpret_cast<const char*>(context->uc_mcontext.fpregs);
+    if (fpstate == nullptr) {
+        return 0;
+    }
+    uint32_t swBytes[2];    // magic1 and extended_size of struct _fpx_sw_bytes
+    memcpy(swBytes, fpstate + FPX_SW_BYTES_OFFSET, sizeof(swBytes));
+    return swBytes[0] == FP_XSTATE_MAGIC1 ? swBytes[1] : FXSAVE_SIZE;
+#else
+    return 0;
+#endif
+}
+
+// Copies the template context and points it at the top of the thread's stack, instead of a sigsetjmp per thread.
+// The mask is filled in now, not at spawn, to hold the signals routed to uthread_signal_wait by then.
+void Thread::start() {
+    size_t size = sharedMode ? SHARED_STACK_SIZE : STACK_SIZE;
+    stack = sharedMode ? sharedStack : stacks + static_cast<size_t>(id) * STACK_SIZE;
+    memcpy(env, templateEnv, sizeof(sigjmp_buf));
+    env->__jmpbuf[JB_SP] = translate_address((address_t)(stack + size - sizeof(address_t)));
+    env->__jmpbuf[JB_PC] = templatePc;
+    Signals::initMask(&env->__saved_mask);
+    started = true;
+}
+
+bool Thread::isStarted() const {
+    return started;
+}
+
+// Copies the context the timer signal interrupted, which the kernel left on the carrier's signal stack, into the
+// thread's PreemptFrame, pointing fpregs at the copy of the XSAVE area.
+void Thread::savePreempted(const ucontext_t* context) {
+    auto* frame = reinterpret_cast<PreemptFrame*>(frames + static_cast<size_t>(id) * frameSize);
+    size_t size = fpstateSizeOf(context);
+    if (size > fpstateSize) {
+        std::cerr << "system error: signal frame larger than measured at init\n";
+        exit(1);
+    }
+    memcpy(&frame->uc, context, sizeof(ucontext_t));
+    if (size > 0) {
+        memcpy(frame->fpstate, context->uc_mcontext.fpregs, size);
+        frame->uc.uc_mcontext.fpregs = reinterpret_cast<fpregset_t>(frame->fpstate);
+    }
+#ifdef __x86_64__
+    stackLow = reinterpret_cast<char*>(context->uc_mcontext.gregs[REG_RSP]) - RED_ZONE;
+#endif
+    preempted = true;
+}
+
+bool Thread::isPreempted() const {
+    return preempted;
+}
+
+// The saved context, to resume with rt_sigreturn. The thread is no longer considered preempted.
+ucontext_t* Thread::takePreempted() {
+    preempted = false;
+    return &reinterpret_cast<PreemptFrame*>(frames + static_cast<size_t>(id) * frameSize)->uc;
+}
+
+// Threads started while the mode is on all run on one SHARED_STACK_SIZE stack, which holds the frames of one of
+// them at a time; the others keep only the live part of theirs, copied out in claimStack. Only switched while no
+// thread but the main one exists.
+void Thread::setSharedStack(bool enabled) {
+    if (enabled && sharedStack == nullptr) {
+        sharedStack = new(std::nothrow) char[SHARED_STACK_SIZE];
+        if (sharedStack == nullptr) {
+            std::cerr << "system error: cannot allocate shared stack\n";
+            exit(1);
+        }
+    }
+    sharedMode = enabled;
+}
+
+bool Thread::isSharedStack() {
+    return sharedMode;
+}
+
+// Records where the thread's live stack ends as it is switched out, for claimStack to copy no more than that.
+void Thread::setStackLow(char* sp) {
+    stackLow = sp;
+}
+
+// Puts the thread's frames back on the shared stack before it runs. Whoever ran there last is copied out only now,
+// so switching to the main thread and back, or to a thread that stays on the stack, copies nothing. Runs on the
+// scheduler stack.
+void Thread::claimStack() {
+    if (stack == nullptr || stack != sharedStack || sharedOwner == this) {
+        return;
+    }
+    if (sharedOwner != nullptr) {
+        sharedOwner->saveStack();
+    }
+    sharedOwner = this;
+    if (stackCopySize > 0) {
+        memcpy(stackLow, stackCopy, stackCopySize);
+        stackCopySize = 0;
+    }
+}
+
+// Copies the live part of the stack, from stackLow to the top, into a buffer of exactly that size.
+void Thread::saveStack() {
+    size_t size = static_cast<size_t>(sharedStack + SHARED_STACK_SIZE - stackLow);
+    if (size != stackCopyCapacity) {
+        char* copy = static_cast<char*>(realloc(stackCopy, size));
+        if (copy == nullptr) {
+            std::cerr << "system error: cannot allocate stack copy\n";
+            exit(1);
+        }
+        stackCopy = copy;
+        stackCopyCapacity = size;
+    }
+    memcpy(stackCopy, stackLow, size);
+    stackCopySize = size;
+}
+
+// Where an object on the thread's stack is now: in its copy while another thread has the shared stack, otherwise
+// where it always was.
+void* Thread::locate(void* address) {
+    char* byte = static_cast<char*>(address);
+    if (stackCopySize == 0 || byte < stackLow || byte >= stackLow + stackCopySize) {
+        return address;
     }
+    return stackCopy + (byte - stackLow);
 }
 
-Thread::~Thread() {
-    if (id != 0 && stack != nullptr) {
-        delete[] stack;
+// count cleared waiters for the thread to park with. They live in the thread rather than on its stack, so wakers
+// reach them even while the stack is copied out.
+uthread_waiter* Thread::takeWaiters(int count) {
+    for (int i = 0; i < count; i++) {
+        waiterSlots[i] = uthread_waiter();
     }
+    return waiterSlots;
 }
 
 ThreadState Thread::getState() const {
@@ -79,4 +272,138 @@ bool Thread::isUserBlocked()const{
 
 void Thread::setBlockFlag(const bool flag) {
     didUserBlock = flag;
-}
\ No newline at end of file
+}
+
+int Thread::getLastRunQuantum() const {
+    return lastRunQuantum;
+}
+
+void Thread::setLastRunQuantum(const int quantum) {
+    lastRunQuantum = quantum;
+}
+
+bool Thread::isWokenAffine() const {
+    return wokenAffine;
+}
+
+void Thread::setWokenAffine(const bool flag) {
+    wokenAffine = flag;
+}
+
+bool Thread::isHandedOff() const {
+    return handedOff;
+}
+
+void Thread::setHandedOff(const bool flag) {
+    handedOff = flag;
+}
+
+bool Thread::isKillPending() const {
+    return killPending;
+}
+
+void Thread::setKillPending(const bool flag) {
+    killPending = flag;
+}
+
+int Thread::getGroupId() const {
+    return groupId;
+}
+
+void Thread::setGroupId(const int gid) {
+    groupId = gid;
+}
+
+int Thread::getGangRound() const {
+    return gangRound;
+}
+
+void Thread::setGangRound(const int round) {
+    gangRound = round;
+}
+
+bool Thread::isParked() const {
+    return parked;
+}
+
+void Thread::setParked(const bool flag) {
+    parked = flag;
+}
+
+struct uthread_waiter* Thread::getWaiters() const {
+    return waiters;
+}
+
+void Thread::setWaiters(struct uthread_waiter* chain) {
+    waiters = chain;
+}
+
+void Thread::setEntry(thread_entry_point entry, thread_routine start, void* startArg) {
+    entryPoint = entry;
+    routine = start;
+    arg = startArg;
+}
+
+thread_entry_point Thread::getEntryPoint() const {
+    return entryPoint;
+}
+
+thread_routine Thread::getRoutine() const {
+    return routine;
+}
+
+void* Thread::getArg() const {
+    return arg;
+}
+
+void* Thread::getRetval() const {
+    return retval;
+}
+
+void Thread::setRetval(void* value) {
+    retval = value;
+}
+
+uthread_waitq_t* Thread::getJoiners() {
+    return &joiners;
+}
+
+int Thread::getBasePriority() const {
+    return basePriority;
+}
+
+void Thread::setBasePriority(const int value) {
+    basePriority = value;
+}
+
+int Thread::getPriority() const {
+    return priority;
+}
+
+void Thread::setPriority(const int value) {
+    priority = value;
+}
+
+uthread_mutex_t* Thread::getPiBlockedOn() const {
+    return piBlockedOn;
+}
+
+void Thread::setPiBlockedOn(uthread_mutex_t* mutex) {
+    piBlockedOn = mutex;
+}
+
+uthread_mutex_t* Thread::getPiHeld() const {
+    return piHeld;
+}
+
+void Thread::setPiHeld(uthread_mutex_t* mutex) {
+    piHeld = mutex;
+}
+
+void** Thread::getSpecific() {
+    return specific;
+}
+
+Arena* Thread::getArena() {
+    return &arena;
+}
@@ -3,7 +3,12 @@
 
 #include <setjmp.h>
 #include <signal.h>
+#include <ucontext.h>
 #include <cassert>    // or <assert.h>
+#include <cstddef>
+#include "uthreads.h"
+#include "arena.h"
+#include "waitqueue.h"
 
 
 #define STACK_SIZE 4096
@@ -22,6 +27,14 @@ typedef unsigned int address_t;
 // Thread states
 enum ThreadState { READY, RUNNING, BLOCKED };
 
+// The context of a thread preempted by the timer, copied off the carrier's signal stack in the layout rt_sigreturn
+// resumes from, followed by the XSAVE area its fpregs points to.
+struct PreemptFrame {
+    void* pretcode;                 // rt_sigreturn finds the frame 8 bytes below the stack pointer
+    ucontext_t uc;
+    alignas(64) char fpstate[1];    // fpstateSize bytes, aligned for XRSTOR
+};
+
 class Thread {
 
 private:
@@ -31,13 +44,82 @@ private:
     char* stack;
     int quantumCount;
     bool didUserBlock;
+    int lastRunQuantum;     // total quantum in which the thread last started running
+    bool wokenAffine;       // queued at the head of READY by a cache-affine wakeup
+    bool handedOff;         // stuck in a blocking region while another carrier runs the scheduler
+    bool killPending;       // terminated while handed off, exits when the blocking region ends
+    int groupId;            // gang scheduling group, -1 if none
+    int gangRound;          // last gang round of its group in which the thread ran
+    bool parked;            // BLOCKED on the wait queue of a synchronization object
+    struct uthread_waiter* waiters; // waiters the thread has queued while parked, chained through sibling
+    thread_entry_point entryPoint;  // entry of a uthread_spawn thread
+    thread_routine routine;         // entry of a uthread_spawn_routine thread, which is joinable
+    void* arg;                      // argument of routine
+    void* retval;                   // exit value handed to joiners
+    uthread_waitq_t joiners;        // threads parked in uthread_join on this one
+    int basePriority;               // set by uthread_set_priority
+    int priority;                   // effective priority: the base, raised by priority inheritance
+    uthread_mutex_t* piBlockedOn;   // PI mutex the thread is queued on, for walking inheritance chains
+    uthread_mutex_t* piHeld;        // contended PI mutexes it owns, chained through pi_next
+    void* specific[UTHREAD_KEYS_MAX];   // values of the thread-local keys, indexed by key
+    Arena arena;                    // memory from uthread_alloc, released when the thread is destroyed
+    bool started;                   // has a stack and context, built when it is first scheduled
+    bool preempted;                 // was last switched out by the timer, its context is in its PreemptFrame
+    uthread_waiter waiterSlots[UTHREAD_SELECT_MAX_CASES];   // the waiters it parks with, see takeWaiters
+    char* stackLow;                 // lowest live byte of its stack when last switched out
+    char* stackCopy;                // on the shared stack: its live part, while another thread runs there
+    size_t stackCopySize;
+    size_t stackCopyCapacity;
 
     static address_t translate_address(address_t addr);
 
+    static Thread* slab;    // one Thread per tid, built in place by create
+    static char* stacks;    // one STACK_SIZE stack per tid
+    static sigjmp_buf templateEnv;  // context captured at init that every thread starts from
+    static address_t templatePc;    // the threads' entry point, already translated
+    static char* frames;            // one PreemptFrame per tid, frameSize bytes each
+    static size_t frameSize;
+    static size_t fpstateSize;      // XSAVE area of the process's signal frames, 0 without preemption
+    static bool sharedMode;         // threads started from now on run on sharedStack
+    static char* sharedStack;       // SHARED_STACK_SIZE bytes, allocated when the mode is first enabled
+    static Thread* sharedOwner;     // thread whose frames are on sharedStack, null if none
+
+    void saveStack();
+
 public:
-    Thread(int id, void (*entryPoint)());
+    explicit Thread(int id);
+
+    static void initPool(void (*entryPoint)(), size_t fpstateBytes);
+
+    static size_t fpstateSizeOf(const ucontext_t* context);
+
+    static Thread* create(int id);
+
+    static void destroy(Thread* thread);
+
+    void start();
+
+    bool isStarted() const;
+
+    void savePreempted(const ucontext_t* context);
+
+    bool isPreempted() const;
+
+    ucontext_t* takePreempted();
 
-    ~Thread();
+    static void setSharedStack(bool enabled);
+
+    static bool isSharedStack();
+
+    void setStackLow(char* sp);
+
+    void claimStack();
+
+    void* locate(void* address);
+
+    uthread_waiter* takeWaiters(int count);
+
+    static void setupContext(sigjmp_buf& env, char* stack, size_t size, void (*entryPoint)());
 
     ThreadState getState() const;
 
@@ -53,6 +135,72 @@ public:
 
     void setBlockFlag(bool shouldSleep);
 
+    int getLastRunQuantum() const;
+
+    void setLastRunQuantum(int quantum);
+
+    bool isWokenAffine() const;
+
+    void setWokenAffine(bool flag);
+
+    bool isHandedOff() const;
+
+    void setHandedOff(bool flag);
+
+    bool isKillPending() const;
+
+    void setKillPending(bool flag);
+
+    int getGroupId() const;
+
+    void setGroupId(int gid);
+
+    int getGangRound() const;
+
+    void setGangRound(int round);
+
+    bool isParked() const;
+
+    void setParked(bool flag);
+
+    struct uthread_waiter* getWaiters() const;
+
+    void setWaiters(struct uthread_waiter* chain);
+
+    void setEntry(thread_entry_point entry, thread_routine start, void* startArg);
+
+    thread_entry_point getEntryPoint() const;
+
+    thread_routine getRoutine() const;
+
+    void* getArg() const;
+
+    void* getRetval() const;
+
+    void setRetval(void* value);
+
+    uthread_waitq_t* getJoiners();
+
+    int getBasePriority() const;
+
+    void setBasePriority(int value);
+
+    int getPriority() const;
+
+    void setPriority(int value);
+
+    uthread_mutex_t* getPiBlockedOn() const;
+
+    void setPiBlockedOn(uthread_mutex_t* mutex);
+
+    uthread_mutex_t* getPiHeld() const;
+
+    void setPiHeld(uthread_mutex_t* mutex);
+
+    void** getSpecific();
+
+    Arena* getArena();
+
 };
 
 #endif // THREAD_H
\ No newline at end of file
@@ -0,0 +1,91 @@
+#include "timer.h"
+#include "scheduler.h"
+#include "deadline.h"
+#include <iostream>
+
+// Static variables initialization
+Timer Timers::timers[UTHREAD_MAX_TIMERS];
+int Timers::freeTimer = -1;
+bool Timers::started = false;
+bool Timers::firing = false;
+
+//************************* Implementation of the private functions ****************************************************
+void Timers::release(int id) {
+  timers[id].state = TIMER_FREE;
+  timers[id].nextFree = freeTimer;
+  freeTimer = id;
+}
+
+// **************************** Implementation of the Timers API ******************************************************
+// True while a callback runs. The timer signal is blocked throughout, and the library's calls leave it blocked.
+bool Timers::inCallback() {
+  return firing;
+}
+
+// Returns the new timer's ID.
+int Timers::add(long delayUsecs, long periodUsecs, uthread_timer_callback callback, void* arg) {
+  Scheduler::blockTimerSignal();
+  if (!started) {
+    for (int i = 0; i < UTHREAD_MAX_TIMERS; i++) {
+      timers[i].nextFree = i + 1 < UTHREAD_MAX_TIMERS ? i + 1 : -1;
+    }
+    freeTimer = 0;
+    started = true;
+  }
+  if (freeTimer == -1) {
+    std::cerr << "thread library error: too many timers" << std::endl;
+    Scheduler::unblockTimerSignal();
+    return -1;
+  }
+  int id = freeTimer;
+  Timer* timer = &timers[id];
+  freeTimer = timer->nextFree;
+  timer->callback = callback;
+  timer->arg = arg;
+  timer->due = Deadlines::after(delayUsecs);
+  timer->period = periodUsecs * 1000LL;
+  timer->state = TIMER_PENDING;
+  Deadlines::set(TIMER_SLOT(id), timer->due);
+  Scheduler::unblockTimerSignal();
+  return id;
+}
+
+// A timer cancelled from its own callback is released once the callback returns.
+int Timers::cancel(int id) {
+  Scheduler::blockTimerSignal();
+  Timer* timer = &timers[id];
+  if (timer->state == TIMER_FREE || timer->state == TIMER_CANCELLED) {
+    std::cerr << "thread library error: no such timer" << std::endl;
+    Scheduler::unblockTimerSignal();
+    return -1;
+  }
+  if (timer->state == TIMER_FIRING) {
+    timer->state = TIMER_CANCELLED;
+  } else {
+    Deadlines::cancel(TIMER_SLOT(id));
+    release(id);
+  }
+  Scheduler::unblockTimerSignal();
+  return 0;
+}
+
+// Runs the callback of a timer whose deadline the scheduler just popped, then schedules its next run. A periodic
+// timer keeps to its original schedule; runs missed while the process was busy are skipped, not made up in a burst.
+// Timer signal blocked.
+void Timers::fire(int id, long long now) {
+  Timer* timer = &timers[id];
+  timer->state = TIMER_FIRING;
+  firing = true;
+  timer->callback(timer->arg);
+  firing = false;
+  if (timer->state == TIMER_CANCELLED || timer->period == 0) {
+    release(id);
+    return;
+  }
+  timer->due += timer->period;
+  if (timer->due <= now) {
+    timer->due += ((now - timer->due) / timer->period + 1) * timer->period;
+  }
+  timer->state = TIMER_PENDING;
+  Deadlines::set(TIMER_SLOT(id), timer->due);
+}
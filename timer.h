@@ -0,0 +1,41 @@
+//
+// Timer callbacks run by the scheduler itself, without a thread per timer. Each timer is a deadline in the same heap
+// as the threads' sleeps, in a slot past the thread IDs; when it passes, the scheduler calls the callback right
+// where it wakes sleepers, and a periodic timer goes back on the heap.
+//
+
+#ifndef _TIMER_H_
+#define _TIMER_H_
+
+#include "uthreads.h"
+
+#define TIMER_SLOT(id) (MAX_THREAD_NUM + (id))  /* a timer's slot in Deadlines */
+
+enum TimerState { TIMER_FREE, TIMER_PENDING, TIMER_FIRING, TIMER_CANCELLED };
+
+struct Timer {
+    uthread_timer_callback callback;
+    void* arg;
+    long long due;          // CLOCK_MONOTONIC nanoseconds
+    long long period;       // nanoseconds, 0 for a one-shot timer
+    TimerState state;
+    int nextFree;           // free list link, -1 at the end
+};
+
+class Timers {
+private:
+    static void release(int id);
+
+    static Timer timers[UTHREAD_MAX_TIMERS];
+    static int freeTimer;
+    static bool started;
+    static bool firing;
+
+public:
+    static bool inCallback();
+    static int add(long delayUsecs, long periodUsecs, uthread_timer_callback callback, void* arg);
+    static int cancel(int id);
+    static void fire(int id, long long now);
+};
+
+#endif //_TIMER_H_
@@ -0,0 +1,277 @@
+#include "uring.h"
+#include "scheduler.h"
+#include "waitqueue.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+// Everything touching the rings runs with the timer signal blocked, so only one uthread at a time fills the
+// submission queue and the kernel only ever sees whole entries.
+
+// Static variables initialization
+int Uring::ringFd = -1;
+unsigned* Uring::sqHead = nullptr;
+unsigned* Uring::sqTail = nullptr;
+unsigned Uring::sqMask = 0;
+unsigned* Uring::sqArray = nullptr;
+io_uring_sqe* Uring::sqes = nullptr;
+unsigned* Uring::cqHead = nullptr;
+unsigned* Uring::cqTail = nullptr;
+unsigned Uring::cqMask = 0;
+io_uring_cqe* Uring::cqes = nullptr;
+unsigned Uring::queued = 0;
+int Uring::inFlight = 0;
+int Uring::freeOp = -1;
+UringOp Uring::ops[URING_ENTRIES];
+uthread_waitq_t Uring::opWaiters;
+
+//************************* Implementation of the private functions ****************************************************
+// A cleared entry at the tail of the submission queue, not yet visible to the kernel. The queue only fills up when
+// more was queued in this round than it holds, so submitting early makes room.
+io_uring_sqe* Uring::nextSqe() {
+  while (*sqTail - __atomic_load_n(sqHead, __ATOMIC_ACQUIRE) > sqMask) {
+    submit();
+    reap();
+  }
+  unsigned index = *sqTail & sqMask;
+  sqArray[index] = index;
+  io_uring_sqe* sqe = &sqes[index];
+  memset(sqe, 0, sizeof(*sqe));
+  return sqe;
+}
+
+// Parks until an operation slot is free when URING_ENTRIES are already in flight. Returns -1, with the timer
+// signal unblocked, if parking fails.
+int Uring::acquireOp() {
+  while (freeOp == -1) {
+    uthread_waiter& waiter = *Scheduler::takeWaiters(1);
+    Scheduler::addWaiter(&opWaiters, &waiter);
+    if (Scheduler::parkCurrent(0) < 0) {
+      return -1;
+    }
+    Scheduler::blockTimerSignal();
+  }
+  int index = freeOp;
+  freeOp = ops[index].nextFree;
+  return index;
+}
+
+void Uring::releaseOp(int index) {
+  ops[index].nextFree = freeOp;
+  freeOp = index;
+  uthread_waiter* waiter = WaitQueue::pop(&opWaiters);
+  if (waiter != nullptr) {
+    Scheduler::unpark(waiter);
+  }
+}
+
+// Queues the filled entry for the next round's submission and parks until its completion is reaped. Called with the
+// timer signal blocked; returns with it unblocked.
+ssize_t Uring::run(io_uring_sqe* sqe, int index) {
+  sqe->user_data = static_cast<uint64_t>(index) + 1;
+  __atomic_store_n(sqTail, *sqTail + 1, __ATOMIC_RELEASE);
+  queued++;
+  inFlight++;
+
+  int result = 0;
+  uthread_waiter& waiter = *Scheduler::takeWaiters(1);
+  waiter.data = &result;
+  Scheduler::addWaiter(&ops[index].waiters, &waiter);
+  if (Scheduler::parkCurrent(0) < 0) {
+    errno = EDEADLK;
+    return -1;
+  }
+  if (result < 0) {
+    // Cancelled by uthread_close, like a thread woken by it in the epoll backend.
+    errno = result == -ECANCELED ? EBADF : -result;
+    return -1;
+  }
+  return result;
+}
+
+// **************************** Implementation of the Uring API ******************************************************
+// Sets up the rings on first use. Returns false when the kernel does not offer io_uring, or too old a version of it,
+// so the caller can stay on epoll.
+bool Uring::start() {
+  if (ringFd != -1) {
+    return true;
+  }
+  io_uring_params params{};
+  int fd = static_cast<int>(syscall(__NR_io_uring_setup, URING_ENTRIES, &params));
+  if (fd < 0) {
+    return false;
+  }
+  // Reads and writes at the current file position need offset -1.
+  if (!(params.features & IORING_FEAT_RW_CUR_POS)) {
+    ::close(fd);
+    return false;
+  }
+
+  size_t sqSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+  size_t cqSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+  bool singleMap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+  if (singleMap) {
+    sqSize = cqSize = std::max(sqSize, cqSize);
+  }
+  size_t sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+  void* sq = mmap(nullptr, sqSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+  void* cq = singleMap ? sq : mmap(nullptr, cqSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd,
+                                   IORING_OFF_CQ_RING);
+  void* sqeMap = mmap(nullptr, sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+  if (sq == MAP_FAILED || cq == MAP_FAILED || sqeMap == MAP_FAILED) {
+    if (sq != MAP_FAILED) {
+      munmap(sq, sqSize);
+    }
+    if (!singleMap && cq != MAP_FAILED) {
+      munmap(cq, cqSize);
+    }
+    if (sqeMap != MAP_FAILED) {
+      munmap(sqeMap, sqesSize);
+    }
+    ::close(fd);
+    return false;
+  }
+
+  char* sqBase = static_cast<char*>(sq);
+  char* cqBase = static_cast<char*>(cq);
+  sqHead = reinterpret_cast<unsigned*>(sqBase + params.sq_off.head);
+  sqTail = reinterpret_cast<unsigned*>(sqBase + params.sq_off.tail);
+  sqMask = *reinterpret_cast<unsigned*>(sqBase + params.sq_off.ring_mask);
+  sqArray = reinterpret_cast<unsigned*>(sqBase + params.sq_off.array);
+  sqes = static_cast<io_uring_sqe*>(sqeMap);
+  cqHead = reinterpret_cast<unsigned*>(cqBase + params.cq_off.head);
+  cqTail = reinterpret_cast<unsigned*>(cqBase + params.cq_off.tail);
+  cqMask = *reinterpret_cast<unsigned*>(cqBase + params.cq_off.ring_mask);
+  cqes = reinterpret_cast<io_uring_cqe*>(cqBase + params.cq_off.cqes);
+
+  for (int i = 0; i < URING_ENTRIES; i++) {
+    WaitQueue::init(&ops[i].waiters);
+    ops[i].nextFree = i + 1 < URING_ENTRIES ? i + 1 : -1;
+  }
+  freeOp = 0;
+  WaitQueue::init(&opWaiters);
+  ringFd = fd;
+  return true;
+}
+
+// The ring's descriptor polls readable while completions are waiting, so the idle wait can include it.
+int Uring::fd() {
+  return ringFd;
+}
+
+bool Uring::hasWaiters() {
+  return inFlight > 0;
+}
+
+// Hands everything queued since the last round to the kernel in one io_uring_enter. Whatever the kernel does not
+// take now is retried next round. Timer signal blocked.
+int Uring::submit() {
+  if (queued == 0) {
+    return 0;
+  }
+  long submitted = syscall(__NR_io_uring_enter, ringFd, queued, 0, 0, nullptr, 0);
+  if (submitted < 0) {
+    if (errno == EINTR || errno == EAGAIN || errno == EBUSY) {
+      return 0;
+    }
+    std::cerr << "system error: io_uring_enter failed" << std::endl;
+    exit(1);
+  }
+  queued -= static_cast<unsigned>(submitted);
+  return static_cast<int>(submitted);
+}
+
+// Makes the threads whose operations completed READY, without a syscall. Timer signal blocked.
+int Uring::reap() {
+  if (ringFd == -1) {
+    return 0;
+  }
+  unsigned head = *cqHead;
+  unsigned tail = __atomic_load_n(cqTail, __ATOMIC_ACQUIRE);
+  int reaped = 0;
+  for (; head != tail; head++) {
+    io_uring_cqe* cqe = &cqes[head & cqMask];
+    if (cqe->user_data == 0) {
+      continue; // a cancel request, nobody waits for it
+    }
+    int index = static_cast<int>(cqe->user_data - 1);
+    uthread_waiter* waiter = WaitQueue::pop(&ops[index].waiters);
+    if (waiter != nullptr) {
+      *static_cast<int*>(Scheduler::waiterData(waiter)) = cqe->res;
+      Scheduler::unpark(waiter);
+    }
+    inFlight--;
+    releaseOp(index);
+    reaped++;
+  }
+  __atomic_store_n(cqHead, head, __ATOMIC_RELEASE);
+  return reaped;
+}
+
+// offset -1 reads at, and advances, the current file position.
+ssize_t Uring::read(int fd, void* buf, size_t count, off_t offset) {
+  Scheduler::blockTimerSignal();
+  int index = acquireOp();
+  if (index < 0) {
+    return -1;
+  }
+  io_uring_sqe* sqe = nextSqe();
+  sqe->opcode = IORING_OP_READ;
+  sqe->fd = fd;
+  sqe->addr = reinterpret_cast<uintptr_t>(buf);
+  sqe->len = static_cast<unsigned>(std::min(count, static_cast<size_t>(UINT32_MAX)));
+  sqe->off = static_cast<uint64_t>(offset);
+  return run(sqe, index);
+}
+
+ssize_t Uring::write(int fd, const void* buf, size_t count, off_t offset) {
+  Scheduler::blockTimerSignal();
+  int index = acquireOp();
+  if (index < 0) {
+    return -1;
+  }
+  io_uring_sqe* sqe = nextSqe();
+  sqe->opcode = IORING_OP_WRITE;
+  sqe->fd = fd;
+  sqe->addr = reinterpret_cast<uintptr_t>(buf);
+  sqe->len = static_cast<unsigned>(std::min(count, static_cast<size_t>(UINT32_MAX)));
+  sqe->off = static_cast<uint64_t>(offset);
+  return run(sqe, index);
+}
+
+// The accepted socket stays blocking: io_uring fails operations on non-blocking descriptors with EAGAIN instead of
+// waiting for them.
+int Uring::accept(int fd, struct sockaddr* addr, socklen_t* addrlen) {
+  Scheduler::blockTimerSignal();
+  int index = acquireOp();
+  if (index < 0) {
+    return -1;
+  }
+  io_uring_sqe* sqe = nextSqe();
+  sqe->opcode = IORING_OP_ACCEPT;
+  sqe->fd = fd;
+  sqe->addr = reinterpret_cast<uintptr_t>(addr);
+  sqe->addr2 = reinterpret_cast<uintptr_t>(addrlen);
+  sqe->accept_flags = SOCK_CLOEXEC;
+  return static_cast<int>(run(sqe, index));
+}
+
+// Cancels every operation in flight on fd. Submitted right away: once fd is closed its number may be reused.
+// Timer signal blocked.
+void Uring::cancel(int fd) {
+  if (ringFd == -1 || inFlight == 0) {
+    return;
+  }
+  io_uring_sqe* sqe = nextSqe();
+  sqe->opcode = IORING_OP_ASYNC_CANCEL;
+  sqe->fd = fd;
+  sqe->cancel_flags = IORING_ASYNC_CANCEL_FD | IORING_ASYNC_CANCEL_ALL;
+  __atomic_store_n(sqTail, *sqTail + 1, __ATOMIC_RELEASE);
+  queued++;
+  submit();
+}
@@ -0,0 +1,60 @@
+//
+// io_uring I/O backend, driven with raw syscalls. A uthread doing I/O queues a submission and parks; the scheduler
+// submits everything queued in one io_uring_enter per scheduling round, and reaping a completion makes its thread
+// READY again. The completion ring needs no syscall to read.
+//
+
+#ifndef _URING_H_
+#define _URING_H_
+
+#include "uthreads.h"
+#include <linux/io_uring.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+
+#define URING_ENTRIES 128   /* submission queue size, and the number of operations that may be in flight */
+
+// One operation in flight. The thread waiting for it parks on waiters; a thread terminated meanwhile leaves the
+// queue empty and the completion is simply dropped.
+struct UringOp {
+    uthread_waitq_t waiters;
+    int nextFree;           // free list link, -1 at the end
+};
+
+class Uring {
+private:
+    static io_uring_sqe* nextSqe();
+    static int acquireOp();
+    static void releaseOp(int index);
+    static ssize_t run(io_uring_sqe* sqe, int index);
+
+    static int ringFd;
+    static unsigned* sqHead;
+    static unsigned* sqTail;
+    static unsigned sqMask;
+    static unsigned* sqArray;
+    static io_uring_sqe* sqes;
+    static unsigned* cqHead;
+    static unsigned* cqTail;
+    static unsigned cqMask;
+    static io_uring_cqe* cqes;
+    static unsigned queued;
+    static int inFlight;
+    static int freeOp;
+    static UringOp ops[URING_ENTRIES];
+    static uthread_waitq_t opWaiters;
+
+public:
+    static bool start();
+    static int fd();
+    static bool hasWaiters();
+    static int submit();
+    static int reap();
+
+    static ssize_t read(int fd, void* buf, size_t count, off_t offset);
+    static ssize_t write(int fd, const void* buf, size_t count, off_t offset);
+    static int accept(int fd, struct sockaddr* addr, socklen_t* addrlen);
+    static void cancel(int fd);
+};
+
+#endif //_URING_H_
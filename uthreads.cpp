@@ -2,6 +2,19 @@
 #include <iostream>
 #include "uthreads.h"
 #include "scheduler.h"
+#include "sysmon.h"
+#include "sync.h"
+#include "chan.h"
+#include "futex.h"
+#include "poller.h"
+#include "offload.h"
+#include "deadline.h"
+#include "timer.h"
+#include "signals.h"
+#include "keys.h"
+#include "arena.h"
+#include <cstdint>
+#include <cerrno>
 
 int uthread_init(int quantum_usecs) {
   if (quantum_usecs <= 0) {
@@ -11,6 +24,42 @@ int uthread_init(int quantum_usecs) {
   return Scheduler::init(quantum_usecs);
 }
 
+int uthread_init_embedded(int quantum_usecs) {
+  if (quantum_usecs <= 0) {
+    std::cerr << "thread library error: quantum_usecs must be positive" << std::endl;
+    return -1;
+  }
+  return Scheduler::init(quantum_usecs, true);
+}
+
+int uthread_run_ready(long budget_usecs) {
+  if (!Scheduler::isEmbedded()) {
+    std::cerr << "thread library error: uthread_run_ready needs embedding mode" << std::endl;
+    return -1;
+  }
+  if (Scheduler::getTid() != 0) {
+    std::cerr << "thread library error: only the main thread can run the scheduler" << std::endl;
+    return -1;
+  }
+  if (budget_usecs < 0) {
+    std::cerr << "thread library error: budget cannot be negative" << std::endl;
+    return -1;
+  }
+  return Scheduler::runReady(budget_usecs);
+}
+
+long uthread_next_deadline() {
+  return Scheduler::nextDeadline();
+}
+
+int uthread_get_poll_fd() {
+  return Poller::fd();
+}
+
+int uthread_yield() {
+  return Scheduler::yield();
+}
+
 int uthread_spawn(thread_entry_point entry_point) {
   if (entry_point == nullptr) {
     std::cerr << "thread library error: entryPoint cannot be null" << std::endl;
@@ -19,6 +68,30 @@ int uthread_spawn(thread_entry_point entry_point) {
   return Scheduler::spawn(entry_point);
 }
 
+int uthread_spawn_routine(thread_routine routine, void *arg) {
+  if (routine == nullptr) {
+    std::cerr << "thread library error: routine cannot be null" << std::endl;
+    return -1;
+  }
+  return Scheduler::spawn(nullptr, routine, arg);
+}
+
+int uthread_exit(void *retval) {
+  return Scheduler::exitCurrent(retval);
+}
+
+int uthread_join(int tid, void **retval) {
+  if (tid < 0 || tid >= MAX_THREAD_NUM) {
+    std::cerr << "thread library error: invalid tid" << std::endl;
+    return -1;
+  }
+  if (tid == 0) {
+    std::cerr << "thread library error: cannot join main thread" << std::endl;
+    return -1;
+  }
+  return Scheduler::join(tid, retval);
+}
+
 int uthread_terminate(int tid) {
   if (tid < 0 || tid >= MAX_THREAD_NUM) {
     std::cerr << "thread library error: invalid tid" << std::endl;
@@ -28,6 +101,9 @@ int uthread_terminate(int tid) {
     std::cerr << "thread library error: there is no thread with id: " << tid << std::endl;
     return -1;
   }
+  if (tid == Scheduler::getTid()) {
+    return Scheduler::exitCurrent(nullptr);
+  }
   return Scheduler::terminate(tid);
 }
 
@@ -81,4 +157,734 @@ int uthread_get_total_quantums() {
 
 int uthread_get_quantums(int tid) {
   return Scheduler::getQuantums(tid);
-}
\ No newline at end of file
+}
+
+int uthread_set_priority(int tid, int priority) {
+  if (tid < 0 || tid >= MAX_THREAD_NUM) {
+    std::cerr << "thread library error: invalid tid" << std::endl;
+    return -1;
+  }
+  if (priority < 0 || priority > UTHREAD_MAX_PRIORITY) {
+    std::cerr << "thread library error: priority out of range" << std::endl;
+    return -1;
+  }
+  return Scheduler::setPriority(tid, priority);
+}
+
+int uthread_get_priority(int tid) {
+  if (tid < 0 || tid >= MAX_THREAD_NUM) {
+    std::cerr << "thread library error: invalid tid" << std::endl;
+    return -1;
+  }
+  return Scheduler::getPriority(tid);
+}
+
+int uthread_set_wake_affine(int window_quantums) {
+  if (window_quantums < 0) {
+    std::cerr << "thread library error: window_quantums cannot be negative" << std::endl;
+    return -1;
+  }
+  return Scheduler::setWakeAffine(window_quantums);
+}
+
+int uthread_get_wake_stats(int *affine_wakeups, int *tail_wakeups) {
+  int affine = 0;
+  int tail = 0;
+  Scheduler::getWakeStats(&affine, &tail);
+  if (affine_wakeups != nullptr) {
+    *affine_wakeups = affine;
+  }
+  if (tail_wakeups != nullptr) {
+    *tail_wakeups = tail;
+  }
+  return 0;
+}
+
+int uthread_set_shared_stack(int enabled) {
+  return Scheduler::setSharedStack(enabled != 0);
+}
+
+int uthread_set_syscall_handoff(int threshold_usecs) {
+  if (threshold_usecs < 0) {
+    std::cerr << "thread library error: threshold_usecs cannot be negative" << std::endl;
+    return -1;
+  }
+  return SysMon::setHandoff(threshold_usecs);
+}
+
+int uthread_enter_blocking() {
+  return SysMon::enterBlocking();
+}
+
+int uthread_exit_blocking() {
+  return SysMon::exitBlocking();
+}
+
+int uthread_group_create(int shares) {
+  if (shares <= 0 || shares > UTHREAD_MAX_GROUP_SHARES) {
+    std::cerr << "thread library error: group shares out of range" << std::endl;
+    return -1;
+  }
+  return Scheduler::groupCreate(shares);
+}
+
+int uthread_group_join(int group_id, int tid) {
+  if (tid < 0 || tid >= MAX_THREAD_NUM) {
+    std::cerr << "thread library error: invalid tid" << std::endl;
+    return -1;
+  }
+  if (Scheduler::getThreadById(tid) == nullptr) {
+    std::cerr << "thread library error: there is no thread with id: " << tid << std::endl;
+    return -1;
+  }
+  return Scheduler::groupJoin(group_id, tid);
+}
+
+int uthread_group_leave(int tid) {
+  if (tid < 0 || tid >= MAX_THREAD_NUM) {
+    std::cerr << "thread library error: invalid tid" << std::endl;
+    return -1;
+  }
+  if (Scheduler::getThreadById(tid) == nullptr) {
+    std::cerr << "thread library error: there is no thread with id: " << tid << std::endl;
+    return -1;
+  }
+  return Scheduler::groupLeave(tid);
+}
+
+int uthread_group_destroy(int group_id) {
+  return Scheduler::groupDestroy(group_id);
+}
+
+int uthread_mutex_init(uthread_mutex_t *mutex, int kind) {
+  if (mutex == nullptr) {
+    std::cerr << "thread library error: mutex cannot be null" << std::endl;
+    return -1;
+  }
+  return Sync::mutexInit(mutex, kind);
+}
+
+int uthread_mutex_lock(uthread_mutex_t *mutex) {
+  if (mutex == nullptr) {
+    std::cerr << "thread library error: mutex cannot be null" << std::endl;
+    return -1;
+  }
+  return Sync::mutexLock(mutex);
+}
+
+int uthread_mutex_trylock(uthread_mutex_t *mutex) {
+  if (mutex == nullptr) {
+    std::cerr << "thread library error: mutex cannot be null" << std::endl;
+    return -1;
+  }
+  return Sync::mutexTrylock(mutex);
+}
+
+int uthread_mutex_unlock(uthread_mutex_t *mutex) {
+  if (mutex == nullptr) {
+    std::cerr << "thread library error: mutex cannot be null" << std::endl;
+    return -1;
+  }
+  return Sync::mutexUnlock(mutex);
+}
+
+int uthread_mutex_destroy(uthread_mutex_t *mutex) {
+  if (mutex == nullptr) {
+    std::cerr << "thread library error: mutex cannot be null" << std::endl;
+    return -1;
+  }
+  return Sync::mutexDestroy(mutex);
+}
+
+int uthread_cond_init(uthread_cond_t *cond) {
+  if (cond == nullptr) {
+    std::cerr << "thread library error: condition variable cannot be null" << std::endl;
+    return -1;
+  }
+  return Sync::condInit(cond);
+}
+
+int uthread_cond_wait(uthread_cond_t *cond, uthread_mutex_t *mutex) {
+  if (cond == nullptr || mutex == nullptr) {
+    std::cerr << "thread library error: condition variable and mutex cannot be null" << std::endl;
+    return -1;
+  }
+  return Sync::condWait(cond, mutex, 0);
+}
+
+int uthread_cond_timedwait(uthread_cond_t *cond, uthread_mutex_t *mutex, int num_quantums) {
+  if (cond == nullptr || mutex == nullptr) {
+    std::cerr << "thread library error: condition variable and mutex cannot be null" << std::endl;
+    return -1;
+  }
+  if (num_quantums <= 0) {
+    std::cerr << "thread library error: numQuantums must be positive" << std::endl;
+    return -1;
+  }
+  return Sync::condWait(cond, mutex, num_quantums);
+}
+
+int uthread_cond_signal(uthread_cond_t *cond) {
+  if (cond == nullptr) {
+    std::cerr << "thread library error: condition variable cannot be null" << std::endl;
+    return -1;
+  }
+  return Sync::condSignal(cond);
+}
+
+int uthread_cond_broadcast(uthread_cond_t *cond) {
+  if (cond == nullptr) {
+    std::cerr << "thread library error: condition variable cannot be null" << std::endl;
+    return -1;
+  }
+  return Sync::condBroadcast(cond);
+}
+
+int uthread_cond_destroy(uthread_cond_t *cond) {
+  if (cond == nullptr) {
+    std::cerr << "thread library error: condition variable cannot be null" << std::endl;
+    return -1;
+  }
+  return Sync::condDestroy(cond);
+}
+
+uthread_chan_t *uthread_chan_create(size_t elem_size, size_t capacity) {
+  if (elem_size == 0) {
+    std::cerr << "thread library error: element size must be positive" << std::endl;
+    return nullptr;
+  }
+  return Chan::create(elem_size, capacity, nullptr, nullptr);
+}
+
+int uthread_chan_send(uthread_chan_t *chan, const void *elem) {
+  if (chan == nullptr || elem == nullptr) {
+    std::cerr << "thread library error: channel and element cannot be null" << std::endl;
+    return -1;
+  }
+  return Chan::send(chan, const_cast<void*>(elem));
+}
+
+int uthread_chan_recv(uthread_chan_t *chan, void *elem) {
+  if (chan == nullptr || elem == nullptr) {
+    std::cerr << "thread library error: channel and element cannot be null" << std::endl;
+    return -1;
+  }
+  return Chan::recv(chan, elem);
+}
+
+int uthread_chan_close(uthread_chan_t *chan) {
+  if (chan == nullptr) {
+    std::cerr << "thread library error: channel cannot be null" << std::endl;
+    return -1;
+  }
+  return Chan::close(chan);
+}
+
+int uthread_chan_destroy(uthread_chan_t *chan) {
+  if (chan == nullptr) {
+    std::cerr << "thread library error: channel cannot be null" << std::endl;
+    return -1;
+  }
+  return Chan::destroy(chan);
+}
+
+static bool validSelectCases(uthread_select_case_t *cases, int num_cases) {
+  if (num_cases < 0 || num_cases > UTHREAD_SELECT_MAX_CASES || (num_cases > 0 && cases == nullptr)) {
+    std::cerr << "thread library error: invalid select cases" << std::endl;
+    return false;
+  }
+  for (int i = 0; i < num_cases; i++) {
+    if (cases[i].op != UTHREAD_SELECT_SEND && cases[i].op != UTHREAD_SELECT_RECV) {
+      std::cerr << "thread library error: invalid select op" << std::endl;
+      return false;
+    }
+    if (cases[i].chan != nullptr && cases[i].elem == nullptr) {
+      std::cerr << "thread library error: channel and element cannot be null" << std::endl;
+      return false;
+    }
+  }
+  return true;
+}
+
+int uthread_select(uthread_select_case_t *cases, int num_cases, int num_quantums) {
+  if (num_quantums < UTHREAD_SELECT_NOWAIT) {
+    std::cerr << "thread library error: invalid select timeout" << std::endl;
+    return -1;
+  }
+  if (!validSelectCases(cases, num_cases)) {
+    return -1;
+  }
+  return Chan::select(cases, num_cases, num_quantums);
+}
+
+int uthread_rwlock_init(uthread_rwlock_t *rwlock) {
+  if (rwlock == nullptr) {
+    std::cerr << "thread library error: rwlock cannot be null" << std::endl;
+    return -1;
+  }
+  return Sync::rwlockInit(rwlock);
+}
+
+int uthread_rwlock_rdlock(uthread_rwlock_t *rwlock) {
+  if (rwlock == nullptr) {
+    std::cerr << "thread library error: rwlock cannot be null" << std::endl;
+    return -1;
+  }
+  return Sync::rwlockRdlock(rwlock);
+}
+
+int uthread_rwlock_wrlock(uthread_rwlock_t *rwlock) {
+  if (rwlock == nullptr) {
+    std::cerr << "thread library error: rwlock cannot be null" << std::endl;
+    return -1;
+  }
+  return Sync::rwlockWrlock(rwlock);
+}
+
+int uthread_rwlock_unlock(uthread_rwlock_t *rwlock) {
+  if (rwlock == nullptr) {
+    std::cerr << "thread library error: rwlock cannot be null" << std::endl;
+    return -1;
+  }
+  return Sync::rwlockUnlock(rwlock);
+}
+
+int uthread_rwlock_destroy(uthread_rwlock_t *rwlock) {
+  if (rwlock == nullptr) {
+    std::cerr << "thread library error: rwlock cannot be null" << std::endl;
+    return -1;
+  }
+  return Sync::rwlockDestroy(rwlock);
+}
+
+int uthread_waitgroup_init(uthread_waitgroup_t *wg, int count) {
+  if (wg == nullptr) {
+    std::cerr << "thread library error: wait group cannot be null" << std::endl;
+    return -1;
+  }
+  if (count < 0) {
+    std::cerr << "thread library error: wait group count cannot be negative" << std::endl;
+    return -1;
+  }
+  return Sync::waitgroupInit(wg, count);
+}
+
+int uthread_waitgroup_add(uthread_waitgroup_t *wg, int delta) {
+  if (wg == nullptr) {
+    std::cerr << "thread library error: wait group cannot be null" << std::endl;
+    return -1;
+  }
+  return Sync::waitgroupAdd(wg, delta);
+}
+
+int uthread_waitgroup_done(uthread_waitgroup_t *wg) {
+  if (wg == nullptr) {
+    std::cerr << "thread library error: wait group cannot be null" << std::endl;
+    return -1;
+  }
+  return Sync::waitgroupAdd(wg, -1);
+}
+
+int uthread_waitgroup_wait(uthread_waitgroup_t *wg) {
+  if (wg == nullptr) {
+    std::cerr << "thread library error: wait group cannot be null" << std::endl;
+    return -1;
+  }
+  return Sync::waitgroupWait(wg);
+}
+
+int uthread_wait_on(int *addr, int expected) {
+  if (addr == nullptr) {
+    std::cerr << "thread library error: address cannot be null" << std::endl;
+    return -1;
+  }
+  return Futex::wait(addr, expected, 0);
+}
+
+int uthread_wake(int *addr, int count) {
+  if (addr == nullptr) {
+    std::cerr << "thread library error: address cannot be null" << std::endl;
+    return -1;
+  }
+  if (count <= 0) {
+    std::cerr << "thread library error: count must be positive" << std::endl;
+    return -1;
+  }
+  return Futex::wake(addr, count);
+}
+
+int uthread_sem_init(uthread_sem_t *sem, int value) {
+  if (sem == nullptr) {
+    std::cerr << "thread library error: semaphore cannot be null" << std::endl;
+    return -1;
+  }
+  if (value < 0) {
+    std::cerr << "thread library error: semaphore value cannot be negative" << std::endl;
+    return -1;
+  }
+  return Sync::semInit(sem, value);
+}
+
+int uthread_sem_wait(uthread_sem_t *sem) {
+  if (sem == nullptr) {
+    std::cerr << "thread library error: semaphore cannot be null" << std::endl;
+    return -1;
+  }
+  return Sync::semWait(sem);
+}
+
+int uthread_sem_trywait(uthread_sem_t *sem) {
+  if (sem == nullptr) {
+    std::cerr << "thread library error: semaphore cannot be null" << std::endl;
+    return -1;
+  }
+  return Sync::semTrywait(sem);
+}
+
+int uthread_sem_post(uthread_sem_t *sem) {
+  if (sem == nullptr) {
+    std::cerr << "thread library error: semaphore cannot be null" << std::endl;
+    return -1;
+  }
+  return Sync::semPost(sem);
+}
+
+int uthread_barrier_init(uthread_barrier_t *barrier, int count) {
+  if (barrier == nullptr) {
+    std::cerr << "thread library error: barrier cannot be null" << std::endl;
+    return -1;
+  }
+  if (count <= 0) {
+    std::cerr << "thread library error: count must be positive" << std::endl;
+    return -1;
+  }
+  return Sync::barrierInit(barrier, count);
+}
+
+int uthread_barrier_wait(uthread_barrier_t *barrier) {
+  if (barrier == nullptr) {
+    std::cerr << "thread library error: barrier cannot be null" << std::endl;
+    return -1;
+  }
+  return Sync::barrierWait(barrier);
+}
+
+int uthread_event_init(uthread_event_t *event) {
+  if (event == nullptr) {
+    std::cerr << "thread library error: event cannot be null" << std::endl;
+    return -1;
+  }
+  return Sync::eventInit(event);
+}
+
+int uthread_event_set(uthread_event_t *event) {
+  if (event == nullptr) {
+    std::cerr << "thread library error: event cannot be null" << std::endl;
+    return -1;
+  }
+  return Sync::eventSet(event);
+}
+
+int uthread_event_wait(uthread_event_t *event) {
+  if (event == nullptr) {
+    std::cerr << "thread library error: event cannot be null" << std::endl;
+    return -1;
+  }
+  return Sync::eventWait(event);
+}
+
+ssize_t uthread_read(int fd, void *buf, size_t count) {
+  if (fd < 0) {
+    errno = EBADF;
+    return -1;
+  }
+  return Poller::read(fd, buf, count);
+}
+
+ssize_t uthread_write(int fd, const void *buf, size_t count) {
+  if (fd < 0) {
+    errno = EBADF;
+    return -1;
+  }
+  return Poller::write(fd, buf, count);
+}
+
+int uthread_accept(int fd, struct sockaddr *addr, socklen_t *addrlen) {
+  if (fd < 0) {
+    errno = EBADF;
+    return -1;
+  }
+  return Poller::accept(fd, addr, addrlen);
+}
+
+int uthread_close(int fd) {
+  if (fd < 0) {
+    errno = EBADF;
+    return -1;
+  }
+  return Poller::close(fd);
+}
+
+int uthread_set_io_backend(int backend) {
+  if (backend != UTHREAD_IO_EPOLL && backend != UTHREAD_IO_URING) {
+    std::cerr << "thread library error: invalid I/O backend" << std::endl;
+    return -1;
+  }
+  return Poller::setBackend(backend);
+}
+
+ssize_t uthread_pread(int fd, void *buf, size_t count, off_t offset) {
+  if (fd < 0) {
+    errno = EBADF;
+    return -1;
+  }
+  return Poller::pread(fd, buf, count, offset);
+}
+
+ssize_t uthread_pwrite(int fd, const void *buf, size_t count, off_t offset) {
+  if (fd < 0) {
+    errno = EBADF;
+    return -1;
+  }
+  return Poller::pwrite(fd, buf, count, offset);
+}
+
+ssize_t uthread_sendfile(int out_fd, int in_fd, off_t *offset, size_t count) {
+  if (out_fd < 0 || in_fd < 0) {
+    errno = EBADF;
+    return -1;
+  }
+  return Poller::sendfile(out_fd, in_fd, offset, count);
+}
+
+ssize_t uthread_splice(int fd_in, loff_t *off_in, int fd_out, loff_t *off_out, size_t len, unsigned int flags) {
+  if (fd_in < 0 || fd_out < 0) {
+    errno = EBADF;
+    return -1;
+  }
+  return Poller::splice(fd_in, off_in, fd_out, off_out, len, flags);
+}
+
+int uthread_offload(thread_routine fn, void *arg, void **result) {
+  if (fn == nullptr) {
+    std::cerr << "thread library error: offloaded function cannot be null" << std::endl;
+    return -1;
+  }
+  return Offload::run(fn, arg, result);
+}
+
+int uthread_sleep_usecs(long usecs) {
+  if (usecs < 0) {
+    std::cerr << "thread library error: usecs cannot be negative" << std::endl;
+    return -1;
+  }
+  if (usecs == 0) {
+    return 0;
+  }
+  return Scheduler::sleepUntil(Deadlines::after(usecs));
+}
+
+int uthread_sleep_until(const struct timespec *deadline) {
+  if (deadline == nullptr) {
+    std::cerr << "thread library error: deadline cannot be null" << std::endl;
+    return -1;
+  }
+  return Scheduler::sleepUntil(Deadlines::fromTimespec(deadline));
+}
+
+// The deadline every timed variant waits for; 0 after an invalid timeout.
+static long long timeoutDeadline(long timeout_usecs) {
+  if (timeout_usecs < 0) {
+    std::cerr << "thread library error: timeout cannot be negative" << std::endl;
+    return 0;
+  }
+  return Deadlines::after(timeout_usecs);
+}
+
+int uthread_mutex_lock_usecs(uthread_mutex_t *mutex, long timeout_usecs) {
+  if (mutex == nullptr) {
+    std::cerr << "thread library error: mutex cannot be null" << std::endl;
+    return -1;
+  }
+  long long deadline = timeoutDeadline(timeout_usecs);
+  return deadline == 0 ? -1 : Sync::mutexLock(mutex, deadline);
+}
+
+int uthread_cond_wait_usecs(uthread_cond_t *cond, uthread_mutex_t *mutex, long timeout_usecs) {
+  if (cond == nullptr || mutex == nullptr) {
+    std::cerr << "thread library error: condition variable and mutex cannot be null" << std::endl;
+    return -1;
+  }
+  long long deadline = timeoutDeadline(timeout_usecs);
+  return deadline == 0 ? -1 : Sync::condWait(cond, mutex, 0, deadline);
+}
+
+int uthread_rwlock_rdlock_usecs(uthread_rwlock_t *rwlock, long timeout_usecs) {
+  if (rwlock == nullptr) {
+    std::cerr << "thread library error: rwlock cannot be null" << std::endl;
+    return -1;
+  }
+  long long deadline = timeoutDeadline(timeout_usecs);
+  return deadline == 0 ? -1 : Sync::rwlockRdlock(rwlock, deadline);
+}
+
+int uthread_rwlock_wrlock_usecs(uthread_rwlock_t *rwlock, long timeout_usecs) {
+  if (rwlock == nullptr) {
+    std::cerr << "thread library error: rwlock cannot be null" << std::endl;
+    return -1;
+  }
+  long long deadline = timeoutDeadline(timeout_usecs);
+  return deadline == 0 ? -1 : Sync::rwlockWrlock(rwlock, deadline);
+}
+
+int uthread_sem_wait_usecs(uthread_sem_t *sem, long timeout_usecs) {
+  if (sem == nullptr) {
+    std::cerr << "thread library error: semaphore cannot be null" << std::endl;
+    return -1;
+  }
+  long long deadline = timeoutDeadline(timeout_usecs);
+  return deadline == 0 ? -1 : Sync::semWait(sem, deadline);
+}
+
+int uthread_event_wait_usecs(uthread_event_t *event, long timeout_usecs) {
+  if (event == nullptr) {
+    std::cerr << "thread library error: event cannot be null" << std::endl;
+    return -1;
+  }
+  long long deadline = timeoutDeadline(timeout_usecs);
+  return deadline == 0 ? -1 : Sync::eventWait(event, deadline);
+}
+
+int uthread_waitgroup_wait_usecs(uthread_waitgroup_t *wg, long timeout_usecs) {
+  if (wg == nullptr) {
+    std::cerr << "thread library error: wait group cannot be null" << std::endl;
+    return -1;
+  }
+  long long deadline = timeoutDeadline(timeout_usecs);
+  return deadline == 0 ? -1 : Sync::waitgroupWait(wg, deadline);
+}
+
+int uthread_join_usecs(int tid, void **retval, long timeout_usecs) {
+  if (tid < 0 || tid >= MAX_THREAD_NUM) {
+    std::cerr << "thread library error: invalid tid" << std::endl;
+    return -1;
+  }
+  if (tid == 0) {
+    std::cerr << "thread library error: cannot join main thread" << std::endl;
+    return -1;
+  }
+  long long deadline = timeoutDeadline(timeout_usecs);
+  return deadline == 0 ? -1 : Scheduler::join(tid, retval, deadline);
+}
+
+int uthread_chan_send_usecs(uthread_chan_t *chan, const void *elem, long timeout_usecs) {
+  if (chan == nullptr || elem == nullptr) {
+    std::cerr << "thread library error: channel and element cannot be null" << std::endl;
+    return -1;
+  }
+  long long deadline = timeoutDeadline(timeout_usecs);
+  return deadline == 0 ? -1 : Chan::send(chan, const_cast<void*>(elem), deadline);
+}
+
+int uthread_chan_recv_usecs(uthread_chan_t *chan, void *elem, long timeout_usecs) {
+  if (chan == nullptr || elem == nullptr) {
+    std::cerr << "thread library error: channel and element cannot be null" << std::endl;
+    return -1;
+  }
+  long long deadline = timeoutDeadline(timeout_usecs);
+  return deadline == 0 ? -1 : Chan::recv(chan, elem, deadline);
+}
+
+int uthread_select_usecs(uthread_select_case_t *cases, int num_cases, long timeout_usecs) {
+  long long deadline = timeoutDeadline(timeout_usecs);
+  if (deadline == 0 || !validSelectCases(cases, num_cases)) {
+    return -1;
+  }
+  if (timeout_usecs == 0) {
+    return Chan::select(cases, num_cases, UTHREAD_SELECT_NOWAIT);
+  }
+  return Chan::select(cases, num_cases, 0, deadline);
+}
+
+int uthread_wait_on_usecs(int *addr, int expected, long timeout_usecs) {
+  if (addr == nullptr) {
+    std::cerr << "thread library error: address cannot be null" << std::endl;
+    return -1;
+  }
+  long long deadline = timeoutDeadline(timeout_usecs);
+  return deadline == 0 ? -1 : Futex::wait(addr, expected, 0, deadline);
+}
+
+int uthread_timer_add(long delay_usecs, long period_usecs, uthread_timer_callback callback, void *arg) {
+  if (callback == nullptr) {
+    std::cerr << "thread library error: timer callback cannot be null" << std::endl;
+    return -1;
+  }
+  if (delay_usecs < 0 || period_usecs < 0) {
+    std::cerr << "thread library error: timer delay and period cannot be negative" << std::endl;
+    return -1;
+  }
+  return Timers::add(delay_usecs, period_usecs, callback, arg);
+}
+
+int uthread_timer_cancel(int timer_id) {
+  if (timer_id < 0 || timer_id >= UTHREAD_MAX_TIMERS) {
+    std::cerr << "thread library error: invalid timer id" << std::endl;
+    return -1;
+  }
+  return Timers::cancel(timer_id);
+}
+
+int uthread_signal_wait(const sigset_t *mask) {
+  if (mask == nullptr || sigisemptyset(mask)) {
+    std::cerr << "thread library error: signal mask cannot be null or empty" << std::endl;
+    return -1;
+  }
+  const int reserved[] = {SIGVTALRM, SIGKILL, SIGSTOP, SIGSEGV, SIGBUS, SIGFPE, SIGILL, SIGTRAP};
+  for (int signo : reserved) {
+    if (sigismember(mask, signo) == 1) {
+      std::cerr << "thread library error: cannot wait for signal " << signo << std::endl;
+      return -1;
+    }
+  }
+  return Signals::wait(mask);
+}
+
+int uthread_key_create(uthread_key_t *key, uthread_key_destructor destructor) {
+  if (key == nullptr) {
+    std::cerr << "thread library error: key cannot be null" << std::endl;
+    return -1;
+  }
+  return Keys::create(key, destructor);
+}
+
+int uthread_key_delete(uthread_key_t key) {
+  if (key < 0 || key >= UTHREAD_KEYS_MAX) {
+    std::cerr << "thread library error: invalid key" << std::endl;
+    return -1;
+  }
+  return Keys::remove(key);
+}
+
+void *uthread_getspecific(uthread_key_t key) {
+  if (key < 0 || key >= UTHREAD_KEYS_MAX) {
+    return nullptr;
+  }
+  return Keys::get(key);
+}
+
+int uthread_setspecific(uthread_key_t key, const void *value) {
+  if (key < 0 || key >= UTHREAD_KEYS_MAX) {
+    std::cerr << "thread library error: invalid key" << std::endl;
+    return -1;
+  }
+  return Keys::set(key, value);
+}
+
+void *uthread_alloc(size_t size) {
+  if (size > PTRDIFF_MAX) {
+    std::cerr << "thread library error: allocation too large" << std::endl;
+    return nullptr;
+  }
+  return Arenas::alloc(Scheduler::currentThread()->getArena(), size);
+}
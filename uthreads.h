@@ -6,11 +6,124 @@
 #ifndef _UTHREADS_H
 #define _UTHREADS_H
 
+#include <stddef.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <fcntl.h>
+#include <time.h>
+#include <signal.h>
 
 #define MAX_THREAD_NUM 100 /* maximal number of threads */
 #define STACK_SIZE 4096 /* stack size per thread (in bytes) */
+#define SHARED_STACK_SIZE (1024 * 1024) /* size of the stack threads share in shared-stack mode (in bytes) */
 
 typedef void (*thread_entry_point)(void);
+typedef void *(*thread_routine)(void *arg);
+
+#define UTHREAD_MAX_GROUP_SHARES 10000 /* group CPU shares range from 1 to this */
+
+/* Wait queue of parked threads, embedded in every blocking primitive. Treat as opaque. */
+typedef struct uthread_waitq {
+    struct uthread_waiter *head;
+    struct uthread_waiter *tail;
+} uthread_waitq_t;
+
+#define UTHREAD_MUTEX_FAIR 0    /* unlock hands ownership straight to the longest waiting thread */
+#define UTHREAD_MUTEX_BARGING 1 /* unlock wakes the longest waiting thread, which competes with running threads */
+#define UTHREAD_MUTEX_PI 2      /* unlock hands ownership to the highest priority waiter, whose priority the owner
+                                   inherits meanwhile */
+
+#define UTHREAD_MAX_PRIORITY 99 /* priorities range from 0, the default, to this */
+
+#define UTHREAD_MAX_TIMERS 4096 /* maximal number of timers set with uthread_timer_add at once */
+
+typedef void (*uthread_timer_callback)(void *arg);
+
+#define UTHREAD_KEYS_MAX 64     /* maximal number of thread-local keys created at once */
+
+typedef int uthread_key_t;
+typedef void (*uthread_key_destructor)(void *value);
+
+/* Blocking mutex. Treat as opaque; initialize with UTHREAD_MUTEX_INITIALIZER or uthread_mutex_init. */
+typedef struct uthread_mutex {
+    int state;                  /* 0 when free, otherwise owner tid + 1, plus a flag while threads wait */
+    int kind;
+    uthread_waitq_t waiters;
+    struct uthread_mutex *pi_next;  /* next contended PI mutex of the same owner */
+} uthread_mutex_t;
+
+#define UTHREAD_MUTEX_INITIALIZER {0, UTHREAD_MUTEX_FAIR, {0, 0}, 0}
+
+/* Condition variable. Treat as opaque; initialize with UTHREAD_COND_INITIALIZER or uthread_cond_init. */
+typedef struct uthread_cond {
+    uthread_waitq_t waiters;
+    uthread_mutex_t *mutex;     /* mutex the current waiters wait with */
+} uthread_cond_t;
+
+#define UTHREAD_COND_INITIALIZER {{0, 0}, 0}
+
+/* Reader-writer lock. Treat as opaque; initialize with UTHREAD_RWLOCK_INITIALIZER or uthread_rwlock_init. */
+typedef struct uthread_rwlock {
+    int state;                  /* number of readers, plus flags while a writer holds it or threads wait */
+    int writer;                 /* tid + 1 of the writer holding it, 0 otherwise */
+    uthread_waitq_t readers;
+    uthread_waitq_t writers;
+} uthread_rwlock_t;
+
+#define UTHREAD_RWLOCK_INITIALIZER {0, 0, {0, 0}, {0, 0}}
+
+/* Counting semaphore. Initialize with UTHREAD_SEM_INITIALIZER(value) or uthread_sem_init. */
+typedef struct uthread_sem {
+    int value;
+    int waiters;                /* threads that may be waiting on value */
+} uthread_sem_t;
+
+#define UTHREAD_SEM_INITIALIZER(value) {(value), 0}
+
+/* Barrier for a fixed number of threads. Initialize with uthread_barrier_init. */
+typedef struct uthread_barrier {
+    int count;
+    int arrived;
+    int generation;             /* advanced each time the barrier opens */
+} uthread_barrier_t;
+
+#define UTHREAD_BARRIER_SERIAL_THREAD 1 /* returned to exactly one thread per barrier round */
+
+/* One-shot event. Initialize with UTHREAD_EVENT_INITIALIZER or uthread_event_init. */
+typedef struct uthread_event {
+    int set;
+} uthread_event_t;
+
+#define UTHREAD_EVENT_INITIALIZER {0}
+
+/* Wait group (countdown latch). Treat as opaque; initialize with UTHREAD_WAITGROUP_INITIALIZER or
+ * uthread_waitgroup_init. */
+typedef struct uthread_waitgroup {
+    int count;
+    uthread_waitq_t waiters;
+} uthread_waitgroup_t;
+
+#define UTHREAD_WAITGROUP_INITIALIZER {0, {0, 0}}
+
+/* Channel carrying fixed-size elements. Opaque; created with uthread_chan_create. */
+typedef struct uthread_chan uthread_chan_t;
+
+#define UTHREAD_SELECT_SEND 0
+#define UTHREAD_SELECT_RECV 1
+#define UTHREAD_SELECT_NOWAIT (-1)      /* timeout that makes uthread_select return at once if nothing is ready */
+#define UTHREAD_SELECT_MAX_CASES 16     /* each thread keeps this many waiters to park with */
+
+/* One channel operation of a uthread_select call. */
+typedef struct uthread_select_case {
+    uthread_chan_t *chan;       /* a null channel is never ready */
+    int op;                     /* UTHREAD_SELECT_SEND or UTHREAD_SELECT_RECV */
+    void *elem;                 /* element to send, or buffer to receive into */
+    int closed;                 /* set by uthread_select when a receive fired because the channel is closed */
+} uthread_select_case_t;
+
+#define UTHREAD_IO_EPOLL 0  /* non-blocking calls, retried when epoll reports the descriptor ready (the default) */
+#define UTHREAD_IO_URING 1  /* operations queued on an io_uring and submitted in batches */
+#define UTHREAD_MAX_FDS 1024 /* the epoll backend waits only on descriptors below this */
 
 /* External interface */
 
@@ -29,6 +142,65 @@ typedef void (*thread_entry_point)(void);
 */
 int uthread_init(int quantum_usecs);
 
+
+/**
+ * @brief Initializes the thread library in embedding mode, for a program that already runs its own event loop on
+ * the main thread.
+ *
+ * Like uthread_init, but no virtual timer is set and no signal is used. Threads are not preempted: they run until
+ * they block, sleep, yield or terminate, and only while the main thread is inside uthread_run_ready. quantum_usecs
+ * is how often uthread_next_deadline asks to be called back while threads sleep for quanta.
+ * It is an error to call this function with non-positive quantum_usecs.
+ *
+ * @return On success, return 0. On failure, return -1.
+*/
+int uthread_init_embedded(int quantum_usecs);
+
+
+/**
+ * @brief Embedding mode: runs READY threads on the main thread until none is left or budget_usecs microseconds
+ * have passed, then returns to the caller.
+ *
+ * Each call first collects finished I/O, passed deadlines and due timers, and counts as one quantum. The budget is
+ * checked whenever a thread blocks, yields or terminates, so at least one thread runs, and a thread that computes
+ * without ever giving up the CPU overruns it.
+ * Only the main thread may call this function, and only in embedding mode.
+ *
+ * @return On success, return the number of threads still READY, 0 once the host may wait. On failure, return -1.
+*/
+int uthread_run_ready(long budget_usecs);
+
+
+/**
+ * @brief Embedding mode: how long the host may wait before calling uthread_run_ready again.
+ *
+ * The host should also wait for uthread_get_poll_fd to become readable, which it does when I/O, a signal or an
+ * offloaded call completes.
+ *
+ * @return The number of microseconds until the next sleep, timeout or timer is due, 0 if threads are READY, or -1
+ * if only the poll descriptor can wake a thread.
+*/
+long uthread_next_deadline();
+
+
+/**
+ * @brief Returns a descriptor that polls readable whenever the library has I/O completions, signals or deadlines
+ * to handle, for the host's event loop to wait on in embedding mode.
+ *
+ * @return The descriptor. The library owns it; do not read from or close it.
+*/
+int uthread_get_poll_fd();
+
+
+/**
+ * @brief Moves the RUNNING thread to the end of the READY queue and lets the next READY thread run.
+ *
+ * In embedding mode this is how a long computation lets the others, and the host, run.
+ *
+ * @return On success, return 0. On failure, return -1.
+*/
+int uthread_yield();
+
 /**
  * @brief Creates a new thread, whose entry point is the function entry_point with the signature
  * void entry_point(void).
@@ -37,6 +209,7 @@ int uthread_init(int quantum_usecs);
  * The uthread_spawn function should fail if it would cause the number of concurrent threads to exceed the
  * limit (MAX_THREAD_NUM).
  * Each thread should be allocated with a stack of size STACK_SIZE bytes.
+ * Returning from entry_point terminates the thread.
  * It is an error to call this function with a null entry_point.
  *
  * @return On success, return the ID of the created thread. On failure, return -1.
@@ -44,12 +217,47 @@ int uthread_init(int quantum_usecs);
 int uthread_spawn(thread_entry_point entry_point);
 
 
+/**
+ * @brief Creates a joinable thread that runs routine(arg), in the same way as uthread_spawn.
+ *
+ * The value routine returns, or passes to uthread_exit, is the thread's exit value. A joinable thread that exits
+ * before anyone joins it keeps its ID, and counts towards MAX_THREAD_NUM, until uthread_join collects it.
+ * It is an error to call this function with a null routine.
+ *
+ * @return On success, return the ID of the created thread. On failure, return -1.
+*/
+int uthread_spawn_routine(thread_routine routine, void *arg);
+
+
+/**
+ * @brief Terminates the RUNNING thread with the exit value retval, which threads joining it receive.
+ *
+ * Terminating the main thread this way exits the process, as uthread_terminate(0) does.
+ *
+ * @return The function does not return on success. On failure, return -1.
+*/
+int uthread_exit(void *retval);
+
+
+/**
+ * @brief Blocks the RUNNING thread until the thread with ID tid terminates, without using any quantums meanwhile.
+ *
+ * If retval is not null it receives the thread's exit value, or null if the thread was terminated by another
+ * thread or did not return a value. A joinable thread that already exited is collected at once.
+ * It is an error to join the main thread, the calling thread, or a thread that does not exist.
+ *
+ * @return On success, return 0. On failure, return -1.
+*/
+int uthread_join(int tid, void **retval);
+
+
 /**
  * @brief Terminates the thread with ID tid and deletes it from all relevant control structures.
  *
  * All the resources allocated by the library for this thread should be released. If no thread with ID tid exists it
  * is considered an error. Terminating the main thread (tid == 0) will result in the termination of the entire
- * process using exit(0) (after releasing the assigned library memory).
+ * process using exit(0) (after releasing the assigned library memory). Threads joining the terminated thread are
+ * made READY.
  *
  * @return The function returns 0 if the thread was successfully terminated and -1 otherwise. If a thread terminates
  * itself or the main thread is terminated, the function does not return.
@@ -88,7 +296,8 @@ int uthread_resume(int tid);
  * If the thread which was just RUNNING should also be added to the READY queue, or if multiple threads wake up 
  * at the same time, the order in which they're added to the end of the READY queue doesn't matter.
  * The number of quantums refers to the number of times a new quantum starts, regardless of the reason. Specifically,
- * the quantum of the thread which has made the call to uthread_sleep isn’t counted.
+ * the quantum of the thread which has made the call to uthread_sleep isn’t counted. While no thread is READY the
+ * library idles, waiting for I/O, and counts a quantum for every quantum_usecs that pass.
  * It is considered an error if the main thread (tid == 0) calls this function.
  *
  * @return On success, return 0. On failure, return -1.
@@ -127,4 +336,830 @@ int uthread_get_total_quantums();
 int uthread_get_quantums(int tid);
 
 
+/**
+ * @brief Sets the scheduling priority of the thread with ID tid.
+ *
+ * Whenever a thread is picked to run, the READY thread with the highest priority goes first, in READY order among
+ * equals; while all READY threads have priority 0 the usual order applies. A thread holding a UTHREAD_MUTEX_PI
+ * mutex runs at the highest priority of the threads waiting for it, so that a low priority holder cannot keep a
+ * high priority thread waiting while medium priority threads run.
+ * If no thread with ID tid exists it is considered an error, as is a priority outside [0, UTHREAD_MAX_PRIORITY].
+ *
+ * @return On success, return 0. On failure, return -1.
+*/
+int uthread_set_priority(int tid, int priority);
+
+
+/**
+ * @brief Returns the effective priority of the thread with ID tid, including any priority it inherits.
+ *
+ * If no thread with ID tid exists it is considered an error.
+ *
+ * @return On success, return the priority. On failure, return -1.
+*/
+int uthread_get_priority(int tid);
+
+
+/**
+ * @brief Configures cache-affine wakeups.
+ *
+ * A thread woken by uthread_resume or at the end of a uthread_sleep that last ran no more than window_quantums
+ * quantums ago is placed at the head of the READY list instead of its end, so it runs again while its stack and
+ * working set are still warm in the cache. Consecutive affine dispatches are capped so that threads waking each
+ * other cannot starve the rest of the READY list. A window of 0 (the default) keeps plain FIFO order.
+ * It is an error to call this function with a negative window_quantums.
+ *
+ * @return On success, return 0. On failure, return -1.
+*/
+int uthread_set_wake_affine(int window_quantums);
+
+
+/**
+ * @brief Returns the wakeup placement counters since the library was initialized.
+ *
+ * affine_wakeups receives the number of wakeups queued at the head of the READY list, tail_wakeups the number
+ * queued at its end. Either pointer may be null.
+ *
+ * @return On success, return 0. On failure, return -1.
+*/
+int uthread_get_wake_stats(int *affine_wakeups, int *tail_wakeups);
+
+
+/**
+ * @brief Turns shared-stack mode on (enabled != 0) or off for the threads spawned from now on.
+ *
+ * In this mode all threads but the main one run on a single stack of SHARED_STACK_SIZE bytes. When a thread is
+ * switched out, the live part of its stack stays there until another thread needs the stack, and is then copied to
+ * a buffer of exactly its size. A parked thread with shallow frames thus costs a few hundred bytes rather than a
+ * STACK_SIZE stack, at the price of copying the used part of two stacks on switches between different threads.
+ * Because a thread's stack moves while it is switched out, no other thread, timer callback, offloaded call or io_uring
+ * operation may use a pointer into it then. The library's own blocking calls are exempt: channel elements, join
+ * results and signal masks may live on the blocked thread's stack.
+ * It is an error to switch modes while threads other than the main thread exist, or to enable the mode while
+ * syscall handoff is enabled. The mode is only available on x86_64.
+ *
+ * @return On success, return 0. On failure, return -1.
+*/
+int uthread_set_shared_stack(int enabled);
+
+
+/**
+ * @brief Enables handing the scheduler to a spare kernel thread while a uthread is blocked in the kernel.
+ *
+ * All uthreads share one kernel thread, so a blocking system call normally stalls every one of them. Once enabled,
+ * a monitor thread watches blocking regions opened with uthread_enter_blocking. If one lasts longer than
+ * threshold_usecs microseconds while other threads are READY, the remaining threads keep running on a spare
+ * kernel thread until the call returns. A threshold of 0 (the default) disables the handoff, and the blocking
+ * region markers become no-ops. It is an error to enable the handoff in shared-stack mode.
+ * Note that once a handoff has happened, uthreads may run on different kernel threads, so thread_local variables
+ * (including errno) must not be carried across calls into the library.
+ * It is an error to call this function with a negative threshold_usecs.
+ *
+ * @return On success, return 0. On failure, return -1.
+*/
+int uthread_set_syscall_handoff(int threshold_usecs);
+
+
+/**
+ * @brief Marks the start of a region in which the RUNNING thread may block in the kernel.
+ *
+ * Between this call and uthread_exit_blocking the thread may only make system calls and must not call any other
+ * function of this library. The thread is not preempted inside the region.
+ *
+ * @return On success, return 0. On failure (e.g. the region is already open), return -1.
+*/
+int uthread_enter_blocking();
+
+
+/**
+ * @brief Marks the end of a region opened by uthread_enter_blocking.
+ *
+ * If the other threads were handed to a spare kernel thread meanwhile, the calling thread waits for the next
+ * scheduling point and then continues as the RUNNING thread of a new quantum. If it was blocked or terminated while
+ * in the region, that takes effect now.
+ *
+ * @return On success, return 0. On failure, return -1.
+*/
+int uthread_exit_blocking();
+
+
+/**
+ * @brief Creates a co-scheduling group with the given CPU shares.
+ *
+ * Members of a group run back-to-back: once one member is scheduled, every other READY member runs in the following
+ * quantums before the rest of the READY list, so data they exchange stays hot in the cache. Between groups the CPU
+ * is divided in proportion to their shares, so a busy group cannot starve another. Threads outside any group are
+ * scheduled in plain READY order. At most MAX_THREAD_NUM groups may exist at the same time.
+ * It is an error to call this function with shares outside [1, UTHREAD_MAX_GROUP_SHARES].
+ *
+ * @return On success, return the ID of the created group. On failure, return -1.
+*/
+int uthread_group_create(int shares);
+
+
+/**
+ * @brief Adds the thread with ID tid to the group with ID group_id, leaving any group it was in before.
+ *
+ * If no thread with ID tid or no group with ID group_id exists it is considered an error.
+ *
+ * @return On success, return 0. On failure, return -1.
+*/
+int uthread_group_join(int group_id, int tid);
+
+
+/**
+ * @brief Removes the thread with ID tid from its group. A thread that is in no group is not an error.
+ *
+ * A terminated thread leaves its group automatically. If no thread with ID tid exists it is considered an error.
+ *
+ * @return On success, return 0. On failure, return -1.
+*/
+int uthread_group_leave(int tid);
+
+
+/**
+ * @brief Destroys the group with ID group_id. Its members stay alive outside any group.
+ *
+ * If no group with ID group_id exists it is considered an error.
+ *
+ * @return On success, return 0. On failure, return -1.
+*/
+int uthread_group_destroy(int group_id);
+
+
+/**
+ * @brief Initializes a mutex of the given kind (UTHREAD_MUTEX_FAIR, UTHREAD_MUTEX_BARGING or UTHREAD_MUTEX_PI).
+ *
+ * Locking a free mutex and unlocking one nobody waits for is a single atomic operation. A thread that finds the
+ * mutex held is BLOCKED on a FIFO wait queue instead of spinning. In FAIR mode unlock hands ownership directly to
+ * the longest waiting thread; in BARGING mode it only wakes that thread, and a thread that locks before it runs
+ * gets the mutex instead, which trades fairness for fewer context switches. In PI mode unlock hands ownership to
+ * the waiting thread with the highest priority, and the owner inherits that priority until it unlocks, along
+ * whole chains of threads waiting for each other's mutexes.
+ *
+ * @return On success, return 0. On failure, return -1.
+*/
+int uthread_mutex_init(uthread_mutex_t *mutex, int kind);
+
+
+/**
+ * @brief Locks the mutex, blocking the RUNNING thread while another thread holds it.
+ *
+ * It is an error to lock a mutex the calling thread already holds, or to wait when no other thread could ever
+ * run to unlock it.
+ *
+ * @return On success, return 0. On failure, return -1.
+*/
+int uthread_mutex_lock(uthread_mutex_t *mutex);
+
+
+/**
+ * @brief Locks the mutex if it is free, without blocking.
+ *
+ * @return If the mutex was locked, return 0. If another thread holds it, return 1. On failure, return -1.
+*/
+int uthread_mutex_trylock(uthread_mutex_t *mutex);
+
+
+/**
+ * @brief Unlocks a mutex held by the RUNNING thread, waking the longest waiting thread if there is one.
+ *
+ * It is an error to unlock a mutex the calling thread does not hold.
+ *
+ * @return On success, return 0. On failure, return -1.
+*/
+int uthread_mutex_unlock(uthread_mutex_t *mutex);
+
+
+/**
+ * @brief Destroys a mutex. It is an error to destroy a mutex that is held or waited on.
+ *
+ * @return On success, return 0. On failure, return -1.
+*/
+int uthread_mutex_destroy(uthread_mutex_t *mutex);
+
+
+/**
+ * @brief Initializes a condition variable.
+ *
+ * @return On success, return 0. On failure, return -1.
+*/
+int uthread_cond_init(uthread_cond_t *cond);
+
+
+/**
+ * @brief Atomically unlocks the mutex and blocks the RUNNING thread until the condition variable is signalled.
+ *
+ * The mutex is held again when the function returns. A signalled thread is not woken to compete for the mutex:
+ * it waits on the mutex's queue instead and wakes up already owning it (wait morphing). As with any condition
+ * variable, callers should re-check their predicate after waking.
+ * It is an error to wait with a mutex the calling thread does not hold, or to wait on one condition variable with
+ * two different mutexes at the same time.
+ *
+ * @return On success, return 0. On failure, return -1.
+*/
+int uthread_cond_wait(uthread_cond_t *cond, uthread_mutex_t *mutex);
+
+
+/**
+ * @brief Like uthread_cond_wait, but gives up after num_quantums quantums, counted as in uthread_sleep.
+ *
+ * It is an error to call this function with non-positive num_quantums.
+ *
+ * @return If signalled, return 0. If the timeout expired, return 1. On failure, return -1. The mutex is held
+ * again on return in all cases but an invalid call.
+*/
+int uthread_cond_timedwait(uthread_cond_t *cond, uthread_mutex_t *mutex, int num_quantums);
+
+
+/**
+ * @brief Wakes the longest waiting thread on the condition variable, if there is one.
+ *
+ * @return On success, return 0. On failure, return -1.
+*/
+int uthread_cond_signal(uthread_cond_t *cond);
+
+
+/**
+ * @brief Wakes all threads waiting on the condition variable.
+ *
+ * The waiters are moved onto the mutex's wait queue in one go and get the mutex one at a time as it is unlocked,
+ * rather than all becoming READY at once only to block on the mutex again.
+ *
+ * @return On success, return 0. On failure, return -1.
+*/
+int uthread_cond_broadcast(uthread_cond_t *cond);
+
+
+/**
+ * @brief Destroys a condition variable. It is an error to destroy a condition variable that is waited on.
+ *
+ * @return On success, return 0. On failure, return -1.
+*/
+int uthread_cond_destroy(uthread_cond_t *cond);
+
+
+/**
+ * @brief Creates a channel of elements of elem_size bytes that buffers up to capacity elements.
+ *
+ * With capacity 0 the channel is unbuffered: every send waits for a receiver. A value sent to a thread already
+ * BLOCKED in uthread_chan_recv is copied straight into that thread's buffer, with no intermediate copy, and the
+ * receiver is placed at the head of the READY list so a round trip between two threads costs two context
+ * switches.
+ * It is an error to call this function with elem_size 0.
+ *
+ * @return On success, return the new channel. On failure, return NULL.
+*/
+uthread_chan_t *uthread_chan_create(size_t elem_size, size_t capacity);
+
+
+/**
+ * @brief Sends the element at elem, blocking the RUNNING thread until a receiver or buffer slot takes it.
+ *
+ * It is an error to send on a closed channel, or to wait when no other thread could ever run to receive.
+ *
+ * @return On success, return 0. On failure, return -1.
+*/
+int uthread_chan_send(uthread_chan_t *chan, const void *elem);
+
+
+/**
+ * @brief Receives the next element into elem, blocking the RUNNING thread until one is sent.
+ *
+ * Elements buffered before the channel was closed are still received.
+ *
+ * @return If an element was received, return 0. If the channel is closed and empty, return 1. On failure,
+ * return -1.
+*/
+int uthread_chan_recv(uthread_chan_t *chan, void *elem);
+
+
+/**
+ * @brief Closes the channel. Threads blocked receiving from it wake up with nothing, threads blocked sending to it
+ * fail.
+ *
+ * It is an error to close a channel twice.
+ *
+ * @return On success, return 0. On failure, return -1.
+*/
+int uthread_chan_close(uthread_chan_t *chan);
+
+
+/**
+ * @brief Destroys the channel and the elements still buffered in it.
+ *
+ * It is an error to destroy a channel that threads are blocked on.
+ *
+ * @return On success, return 0. On failure, return -1.
+*/
+int uthread_chan_destroy(uthread_chan_t *chan);
+
+
+/**
+ * @brief Performs whichever of num_cases channel operations can proceed first, blocking the RUNNING thread until
+ * one can or num_quantums quantums have passed.
+ *
+ * If several operations are ready when called, the first one in a rotating order runs, so no case is starved.
+ * Otherwise the thread waits on all the channels at once and the first operation to complete wakes it exactly once;
+ * the others are withdrawn. A receive that fires because its channel is closed sets that case's closed field.
+ * num_quantums is counted as in uthread_sleep; 0 waits with no timeout and UTHREAD_SELECT_NOWAIT does not wait.
+ * It is an error to pass more than UTHREAD_SELECT_MAX_CASES cases, an invalid op, a send to a closed channel, or to
+ * wait forever with no channel at all.
+ *
+ * @return On success, return the index of the case that ran, or num_cases if the timeout expired. On failure,
+ * return -1.
+*/
+int uthread_select(uthread_select_case_t *cases, int num_cases, int num_quantums);
+
+
+/**
+ * @brief Initializes a wait group whose counter starts at count.
+ *
+ * It is an error to call this function with a negative count.
+ *
+ * @return On success, return 0. On failure, return -1.
+*/
+int uthread_waitgroup_init(uthread_waitgroup_t *wg, int count);
+
+
+/**
+ * @brief Adds delta, which may be negative, to the wait group's counter. When it reaches 0 every waiting thread is
+ * made READY at once.
+ *
+ * It is an error for the counter to become negative.
+ *
+ * @return On success, return 0. On failure, return -1.
+*/
+int uthread_waitgroup_add(uthread_waitgroup_t *wg, int delta);
+
+
+/**
+ * @brief Decrements the wait group's counter, as uthread_waitgroup_add(wg, -1) does.
+ *
+ * @return On success, return 0. On failure, return -1.
+*/
+int uthread_waitgroup_done(uthread_waitgroup_t *wg);
+
+
+/**
+ * @brief Blocks the RUNNING thread until the wait group's counter is 0. Returns at once if it already is.
+ *
+ * @return On success, return 0. On failure, return -1.
+*/
+int uthread_waitgroup_wait(uthread_waitgroup_t *wg);
+
+
+/**
+ * @brief Initializes a reader-writer lock.
+ *
+ * @return On success, return 0. On failure, return -1.
+*/
+int uthread_rwlock_init(uthread_rwlock_t *rwlock);
+
+
+/**
+ * @brief Locks the lock for reading, blocking the RUNNING thread while a writer holds it or waits for it.
+ *
+ * Any number of threads may hold the lock for reading at once. While no writer holds or waits for the lock,
+ * locking and unlocking for reading are single atomic operations. Waiting writers take precedence over new
+ * readers, so a steady stream of readers cannot starve them.
+ * It is an error to read-lock a lock the calling thread holds for writing.
+ *
+ * @return On success, return 0. On failure, return -1.
+*/
+int uthread_rwlock_rdlock(uthread_rwlock_t *rwlock);
+
+
+/**
+ * @brief Locks the lock for writing, blocking the RUNNING thread while any other thread holds it.
+ *
+ * It is an error to write-lock a lock the calling thread already holds for writing.
+ *
+ * @return On success, return 0. On failure, return -1.
+*/
+int uthread_rwlock_wrlock(uthread_rwlock_t *rwlock);
+
+
+/**
+ * @brief Releases a read or write hold on the lock by the RUNNING thread.
+ *
+ * The last reader out hands the lock straight to the longest waiting writer. A writer hands it to the next waiting
+ * writer if there is one, and otherwise to all waiting readers at once, which become READY together.
+ * It is an error to unlock a lock the calling thread does not hold.
+ *
+ * @return On success, return 0. On failure, return -1.
+*/
+int uthread_rwlock_unlock(uthread_rwlock_t *rwlock);
+
+
+/**
+ * @brief Destroys a reader-writer lock. It is an error to destroy a lock that is held or waited on.
+ *
+ * @return On success, return 0. On failure, return -1.
+*/
+int uthread_rwlock_destroy(uthread_rwlock_t *rwlock);
+
+
+/**
+ * @brief Blocks the RUNNING thread on the address addr if it still holds expected, until uthread_wake(addr, ...)
+ * wakes it.
+ *
+ * The comparison and the blocking are atomic with respect to other threads, so a thread that changes *addr and
+ * then calls uthread_wake can never leave a waiter behind. This is the building block for custom blocking
+ * primitives: callers re-check their condition after waking.
+ *
+ * @return If woken, return 0. If *addr did not hold expected, return 1 without blocking. On failure, return -1.
+*/
+int uthread_wait_on(int *addr, int expected);
+
+
+/**
+ * @brief Wakes up to count threads blocked in uthread_wait_on(addr, ...), longest waiting first.
+ *
+ * It is an error to call this function with non-positive count.
+ *
+ * @return On success, return the number of threads woken. On failure, return -1.
+*/
+int uthread_wake(int *addr, int count);
+
+
+/**
+ * @brief Initializes a counting semaphore with the given value.
+ *
+ * It is an error to call this function with a negative value.
+ *
+ * @return On success, return 0. On failure, return -1.
+*/
+int uthread_sem_init(uthread_sem_t *sem, int value);
+
+
+/**
+ * @brief Decrements the semaphore, blocking the RUNNING thread while its value is 0.
+ *
+ * @return On success, return 0. On failure, return -1.
+*/
+int uthread_sem_wait(uthread_sem_t *sem);
+
+
+/**
+ * @brief Decrements the semaphore if its value is positive, without blocking.
+ *
+ * @return If decremented, return 0. If the value was 0, return 1. On failure, return -1.
+*/
+int uthread_sem_trywait(uthread_sem_t *sem);
+
+
+/**
+ * @brief Increments the semaphore, waking one blocked thread if there is one.
+ *
+ * @return On success, return 0. On failure, return -1.
+*/
+int uthread_sem_post(uthread_sem_t *sem);
+
+
+/**
+ * @brief Initializes a barrier that opens once count threads have reached it, and then resets for the next round.
+ *
+ * It is an error to call this function with non-positive count.
+ *
+ * @return On success, return 0. On failure, return -1.
+*/
+int uthread_barrier_init(uthread_barrier_t *barrier, int count);
+
+
+/**
+ * @brief Blocks the RUNNING thread until count threads, including it, have reached the barrier.
+ *
+ * @return On success, return UTHREAD_BARRIER_SERIAL_THREAD to the thread that opened the barrier and 0 to the
+ * others. On failure, return -1.
+*/
+int uthread_barrier_wait(uthread_barrier_t *barrier);
+
+
+/**
+ * @brief Initializes a one-shot event in the unset state.
+ *
+ * @return On success, return 0. On failure, return -1.
+*/
+int uthread_event_init(uthread_event_t *event);
+
+
+/**
+ * @brief Sets the event, waking every thread waiting for it. Once set, an event stays set.
+ *
+ * @return On success, return 0. On failure, return -1.
+*/
+int uthread_event_set(uthread_event_t *event);
+
+
+/**
+ * @brief Blocks the RUNNING thread until the event is set. Returns at once if it already is.
+ *
+ * @return On success, return 0. On failure, return -1.
+*/
+int uthread_event_wait(uthread_event_t *event);
+
+
+/**
+ * @brief Reads up to count bytes from fd like read(2), blocking only the RUNNING thread while no data is available.
+ *
+ * The first I/O call on a descriptor switches it to non-blocking mode and registers it with the library's epoll
+ * instance. When the call would block, the thread is BLOCKED until the descriptor is ready; the library checks for
+ * ready descriptors once per quantum, and waits for them whenever no thread is READY.
+ *
+ * Waiting with epoll on a descriptor of UTHREAD_MAX_FDS or above is an error.
+ *
+ * @return As read(2): the number of bytes read, 0 at end of file, or -1 with errno set.
+*/
+ssize_t uthread_read(int fd, void *buf, size_t count);
+
+
+/**
+ * @brief Writes up to count bytes to fd like write(2), blocking only the RUNNING thread while fd is not writable.
+ *
+ * @return As write(2): the number of bytes written, or -1 with errno set.
+*/
+ssize_t uthread_write(int fd, const void *buf, size_t count);
+
+
+/**
+ * @brief Accepts a connection on the listening socket fd like accept(2), blocking only the RUNNING thread until
+ * one arrives. The new socket is non-blocking.
+ *
+ * @return As accept(2): the new socket, or -1 with errno set.
+*/
+int uthread_accept(int fd, struct sockaddr *addr, socklen_t *addrlen);
+
+
+/**
+ * @brief Closes fd like close(2). Threads blocked on fd in uthread_read, uthread_write or uthread_accept fail
+ * with EBADF.
+ *
+ * @return As close(2): 0, or -1 with errno set.
+*/
+int uthread_close(int fd);
+
+
+/**
+ * @brief Selects how uthread_read, uthread_write, uthread_accept, uthread_pread and uthread_pwrite wait.
+ *
+ * With UTHREAD_IO_URING each call queues an operation and blocks the RUNNING thread until it completes. Operations
+ * queued by all threads are submitted together, with one system call per scheduling round: once per quantum, and
+ * whenever no thread is READY. Buffered file reads then run asynchronously too. Descriptors that are non-blocking,
+ * such as those already used with the epoll backend, keep being waited for with epoll.
+ * A thread terminated while its operation is in flight leaves the operation running until it completes, so its
+ * buffer must outlive the thread.
+ * It is an error to switch while threads are blocked on I/O.
+ *
+ * @return The backend in use: UTHREAD_IO_EPOLL when io_uring was asked for but the kernel does not support it.
+ * On failure, return -1.
+*/
+int uthread_set_io_backend(int backend);
+
+
+/**
+ * @brief Reads up to count bytes from fd at offset like pread(2), blocking only the RUNNING thread while the
+ * io_uring backend reads. With the epoll backend this is a plain pread(2).
+ *
+ * @return As pread(2): the number of bytes read, 0 at end of file, or -1 with errno set.
+*/
+ssize_t uthread_pread(int fd, void *buf, size_t count, off_t offset);
+
+
+/**
+ * @brief Writes up to count bytes to fd at offset like pwrite(2), blocking only the RUNNING thread while the
+ * io_uring backend writes. With the epoll backend this is a plain pwrite(2).
+ *
+ * @return As pwrite(2): the number of bytes written, or -1 with errno set.
+*/
+ssize_t uthread_pwrite(int fd, const void *buf, size_t count, off_t offset);
+
+
+/**
+ * @brief Copies up to count bytes from in_fd to out_fd inside the kernel like sendfile(2), blocking only the
+ * RUNNING thread while out_fd is not writable.
+ *
+ * The data never passes through the thread's stack, so a thread with a small stack can serve a large file. Both
+ * descriptors are switched to non-blocking mode and waited for with epoll, whichever backend is selected.
+ *
+ * @return As sendfile(2): the number of bytes copied, which may be less than count, or -1 with errno set.
+*/
+ssize_t uthread_sendfile(int out_fd, int in_fd, off_t *offset, size_t count);
+
+
+/**
+ * @brief Moves up to len bytes between fd_in and fd_out, one of which must be a pipe, like splice(2), blocking only
+ * the RUNNING thread until fd_in is readable or fd_out writable.
+ *
+ * SPLICE_F_NONBLOCK is always added to flags. The descriptors are waited for with epoll, as in uthread_sendfile.
+ *
+ * @return As splice(2): the number of bytes moved, 0 at end of input, or -1 with errno set.
+*/
+ssize_t uthread_splice(int fd_in, loff_t *off_in, int fd_out, loff_t *off_out, size_t len, unsigned int flags);
+
+
+/**
+ * @brief Runs fn(arg) on a helper kernel thread, blocking only the RUNNING thread until it returns.
+ *
+ * Meant for blocking calls with no non-blocking form, like fsync(2) or open(2) on a slow filesystem: the other
+ * threads keep running while the call waits. A small pool of helper threads runs the calls; the library resumes
+ * the caller at its next check for I/O, once per quantum or as soon as no thread is READY.
+ * fn runs outside the library and must not call any uthread_ function.
+ *
+ * @return On success, return 0, with fn's return value in *result unless result is null and errno as fn left it.
+ * On failure, return -1.
+*/
+int uthread_offload(thread_routine fn, void *arg, void **result);
+
+/**
+ * @brief Blocks the RUNNING thread for at least usecs microseconds of CLOCK_MONOTONIC time.
+ *
+ * Unlike uthread_sleep, the time slept does not depend on how often threads switch. While threads keep running, a
+ * thread whose time is up becomes READY at the next quantum; while none is READY, the library wakes it on time.
+ * The main thread may call this function too. Sleeping 0 microseconds returns at once.
+ * It is an error to call this function with negative usecs.
+ *
+ * @return On success, return 0. On failure, return -1.
+*/
+int uthread_sleep_usecs(long usecs);
+
+
+/**
+ * @brief Blocks the RUNNING thread until the absolute CLOCK_MONOTONIC time deadline, as in uthread_sleep_usecs.
+ *
+ * A deadline already passed returns at once.
+ *
+ * @return On success, return 0. On failure, return -1.
+*/
+int uthread_sleep_until(const struct timespec *deadline);
+
+
+/*
+ * Timed variants of the blocking calls. Each behaves like the call it is named after but gives up once
+ * timeout_usecs microseconds of CLOCK_MONOTONIC time have passed, measured as in uthread_sleep_usecs. A timeout of 0
+ * only tries, without blocking. It is an error to pass a negative timeout_usecs.
+ * Unless stated otherwise they return 0 on success, 1 if the timeout expired first, and -1 on failure.
+ */
+int uthread_mutex_lock_usecs(uthread_mutex_t *mutex, long timeout_usecs);
+/* The mutex is held again on return in all cases but an invalid call. */
+int uthread_cond_wait_usecs(uthread_cond_t *cond, uthread_mutex_t *mutex, long timeout_usecs);
+int uthread_rwlock_rdlock_usecs(uthread_rwlock_t *rwlock, long timeout_usecs);
+int uthread_rwlock_wrlock_usecs(uthread_rwlock_t *rwlock, long timeout_usecs);
+int uthread_sem_wait_usecs(uthread_sem_t *sem, long timeout_usecs);
+int uthread_event_wait_usecs(uthread_event_t *event, long timeout_usecs);
+int uthread_waitgroup_wait_usecs(uthread_waitgroup_t *wg, long timeout_usecs);
+int uthread_join_usecs(int tid, void **retval, long timeout_usecs);
+int uthread_chan_send_usecs(uthread_chan_t *chan, const void *elem, long timeout_usecs);
+/* Returns 0 with a value, 1 once the channel is closed and drained, 2 if the timeout expired first. */
+int uthread_chan_recv_usecs(uthread_chan_t *chan, void *elem, long timeout_usecs);
+/* Returns the index of the case that ran, or num_cases if the timeout expired first. */
+int uthread_select_usecs(uthread_select_case_t *cases, int num_cases, long timeout_usecs);
+/* Returns 0 once woken, 1 if *addr did not hold expected, 2 if the timeout expired first. */
+int uthread_wait_on_usecs(int *addr, int expected, long timeout_usecs);
+
+/**
+ * @brief Calls callback(arg) once delay_usecs microseconds of CLOCK_MONOTONIC time have passed, and then every
+ * period_usecs microseconds, or only once if period_usecs is 0.
+ *
+ * No thread is created: the scheduler itself calls the callback, as it wakes sleeping threads, at most a quantum
+ * late while threads are running and on time while none is READY. A periodic timer keeps to its original schedule,
+ * skipping the runs it is too late for.
+ * The callback runs inside the scheduler, on its own stack or the main thread's in embedding mode, with the
+ * scheduler paused, so it must be short and must not block. The only uthread_ functions it may call are
+ * uthread_timer_add, uthread_timer_cancel, uthread_wake, uthread_sem_post, uthread_event_set, uthread_cond_signal,
+ * uthread_cond_broadcast and uthread_resume.
+ * It is an error to call this function with negative delay_usecs or period_usecs, or with more than
+ * UTHREAD_MAX_TIMERS timers set.
+ *
+ * @return On success, return the ID of the new timer. On failure, return -1.
+*/
+int uthread_timer_add(long delay_usecs, long period_usecs, uthread_timer_callback callback, void *arg);
+
+
+/**
+ * @brief Cancels the timer with ID timer_id. A one-shot timer is gone once its callback has run.
+ *
+ * A timer may cancel itself from its callback.
+ * It is an error to cancel a timer that is not set.
+ *
+ * @return On success, return 0. On failure, return -1.
+*/
+int uthread_timer_cancel(int timer_id);
+
+/**
+ * @brief Blocks the RUNNING thread until one of the signals in mask arrives, and accepts it.
+ *
+ * From the first call naming a signal on, that signal is blocked in every thread and the library reads it from a
+ * signalfd along with I/O readiness, so it no longer interrupts whichever thread is running. A routed signal that
+ * arrives while no thread waits for it stays pending, once, for the next thread that does. When several threads
+ * wait for the same signal the one that waited longest gets it.
+ * It is an error to call this function with a null or empty mask, or with a mask holding SIGVTALRM, which the
+ * library uses, a signal that cannot be blocked, or a signal raised by faults such as SIGSEGV.
+ *
+ * @return On success, return the number of the signal that arrived. On failure, return -1.
+*/
+int uthread_signal_wait(const sigset_t *mask);
+
+
+/**
+ * @brief Creates a thread-local key, whose value starts out null in every thread, and stores it in *key.
+ *
+ * Unlike C++ thread_local, which all threads share as they run on the same kernel thread, each thread has its own
+ * value, kept with the thread wherever it runs. When a thread returns from its entry point, calls uthread_exit or
+ * terminates itself, destructor, unless it is null, is called with each non-null value the thread holds, after the
+ * value is reset to null. A destructor that sets values again gets them destroyed too, for a few rounds at most.
+ * A thread terminated by another thread drops its values without destructors.
+ * It is an error to call this function with a null key or with UTHREAD_KEYS_MAX keys already created.
+ *
+ * @return On success, return 0. On failure, return -1.
+*/
+int uthread_key_create(uthread_key_t *key, uthread_key_destructor destructor);
+
+
+/**
+ * @brief Deletes key. The values threads hold for it are dropped without calling its destructor.
+ *
+ * It is an error to delete a key that was not created.
+ *
+ * @return On success, return 0. On failure, return -1.
+*/
+int uthread_key_delete(uthread_key_t key);
+
+
+/**
+ * @brief Returns the RUNNING thread's value for key, null if it set none or key is not a key.
+ *
+ * This call takes no lock and masks no signal, so it is cheap enough for hot paths.
+*/
+void *uthread_getspecific(uthread_key_t key);
+
+
+/**
+ * @brief Sets the RUNNING thread's value for key.
+ *
+ * It is an error to call this function with a key that was not created.
+ *
+ * @return On success, return 0. On failure, return -1.
+*/
+int uthread_setspecific(uthread_key_t key, const void *value);
+
+
+/**
+ * @brief Allocates size bytes, aligned as by malloc, from the RUNNING thread's arena.
+ *
+ * The memory is never freed on its own: all of a thread's allocations go away together when the thread ends,
+ * however it ends. Allocating takes no lock, and the arena grows in chunks taken from a pool that ended threads give
+ * their chunks back to, so threads that make many small allocations that all die with them avoid malloc entirely.
+ * Nothing allocated here may be used after the thread is gone, which includes returning it from a routine to its
+ * joiner.
+ * It is an error to call this function with size larger than PTRDIFF_MAX.
+ *
+ * @return On success, return the memory. On failure, return null.
+*/
+void *uthread_alloc(size_t size);
+
+#ifdef __cplusplus
+#include <new>
+#include <stdint.h>
+
+/*
+ * A standard allocator over uthread_alloc, for containers that live no longer than the thread that fills them:
+ * std::vector<int, uthread_allocator<int> >. deallocate does nothing; the memory is released with the thread.
+ */
+template <typename T>
+struct uthread_allocator {
+    typedef T value_type;
+
+    uthread_allocator() {}
+
+    template <typename U>
+    uthread_allocator(const uthread_allocator<U> &) {}
+
+    T *allocate(size_t n)
+    {
+        void *memory = n > PTRDIFF_MAX / sizeof(T) ? NULL : uthread_alloc(n * sizeof(T));
+        if (memory == NULL)
+        {
+            throw std::bad_alloc();
+        }
+        return static_cast<T *>(memory);
+    }
+
+    void deallocate(T *, size_t) {}
+};
+
+template <typename T, typename U>
+bool operator==(const uthread_allocator<T> &, const uthread_allocator<U> &)
+{
+    return true;
+}
+
+template <typename T, typename U>
+bool operator!=(const uthread_allocator<T> &, const uthread_allocator<U> &)
+{
+    return false;
+}
+#endif
+
+
 #endif
@@ -0,0 +1,66 @@
+#include "waitqueue.h"
+
+// All of these run with the timer signal blocked.
+
+void WaitQueue::init(uthread_waitq_t* queue) {
+  queue->head = nullptr;
+  queue->tail = nullptr;
+}
+
+bool WaitQueue::empty(const uthread_waitq_t* queue) {
+  return queue->head == nullptr;
+}
+
+void WaitQueue::push(uthread_waitq_t* queue, uthread_waiter* waiter) {
+  waiter->next = nullptr;
+  waiter->queue = queue;
+  if (queue->tail == nullptr) {
+    queue->head = waiter;
+  } else {
+    queue->tail->next = waiter;
+  }
+  queue->tail = waiter;
+}
+
+uthread_waiter* WaitQueue::pop(uthread_waitq_t* queue) {
+  uthread_waiter* waiter = queue->head;
+  if (waiter == nullptr) {
+    return nullptr;
+  }
+  queue->head = waiter->next;
+  if (queue->head == nullptr) {
+    queue->tail = nullptr;
+  }
+  waiter->next = nullptr;
+  waiter->queue = nullptr;
+  return waiter;
+}
+
+// Unlinks a waiter from whatever queue it is still on. A no-op for a waiter a waker already dequeued.
+void WaitQueue::remove(uthread_waiter* waiter) {
+  uthread_waitq_t* queue = waiter->queue;
+  if (queue == nullptr) {
+    return;
+  }
+  uthread_waiter* prev = nullptr;
+  for (uthread_waiter* cur = queue->head; cur != nullptr; prev = cur, cur = cur->next) {
+    if (cur == waiter) {
+      unlink(queue, prev, cur);
+      return;
+    }
+  }
+}
+
+// Unlinks a waiter found while walking the queue, given the waiter before it (null at the head).
+void WaitQueue::unlink(uthread_waitq_t* queue, uthread_waiter* prev, uthread_waiter* waiter) {
+  if (prev == nullptr) {
+    queue->head = waiter->next;
+  } else {
+    prev->next = waiter->next;
+  }
+  if (queue->tail == waiter) {
+    queue->tail = prev;
+  }
+  waiter->next = nullptr;
+  waiter->queue = nullptr;
+}
@@ -0,0 +1,38 @@
+//
+// Intrusive FIFO of parked threads, the building block of every blocking primitive.
+//
+
+#ifndef _WAITQUEUE_H_
+#define _WAITQUEUE_H_
+
+#include "uthreads.h"
+
+// uthread_waiter::result values
+#define WAIT_WOKEN 0        // woken by the primitive
+#define WAIT_HANDOFF 1      // woken and already handed what it waited for, e.g. mutex ownership
+#define WAIT_TIMEDOUT 2     // woken because its timeout expired
+#define WAIT_CLOSED 3       // woken because the object it waited on was closed
+
+// One thread waiting on one queue. Lives in the parked thread's Thread (Scheduler::takeWaiters), so parking never
+// allocates and wakers reach it even while the thread's stack is copied out. A thread waiting on several queues at
+// once has one waiter per queue, chained through sibling.
+struct uthread_waiter {
+    int tid;
+    uthread_waiter* next;       // next waiter on the same queue
+    uthread_waitq_t* queue;     // queue it is linked on, null once a waker has dequeued it
+    uthread_waiter* sibling;    // next waiter of the same thread
+    void* data;                 // primitive-specific payload, e.g. a channel element buffer
+    int result;                 // set by the waker
+};
+
+class WaitQueue {
+public:
+    static void init(uthread_waitq_t* queue);
+    static bool empty(const uthread_waitq_t* queue);
+    static void push(uthread_waitq_t* queue, uthread_waiter* waiter);
+    static uthread_waiter* pop(uthread_waitq_t* queue);
+    static void remove(uthread_waiter* waiter);
+    static void unlink(uthread_waitq_t* queue, uthread_waiter* prev, uthread_waiter* waiter);
+};
+
+#endif //_WAITQUEUE_H_